@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <string.h>
+#include "ip.h"
+#include "burst_detector.h"
+
+/* Space-Saving: count bytes of id with a constant number of counters */
+static void SpaceSaving(BurstCounter *counters, int id, int bytes)
+{
+	int min_index = 0;
+
+	for (int i = 0; i < BURST_TOP_NUM; i++) {
+		if (counters[i].id == id) {
+			counters[i].bytes += bytes;
+			return;
+		}
+		if (counters[i].bytes < counters[min_index].bytes)
+			min_index = i;
+	}
+
+	/* replace the smallest counter and inherit its count */
+	counters[min_index].id = id;
+	counters[min_index].bytes += bytes;
+}
+
+/* Sort counters in descending order of bytes */
+static void SortCounters(BurstCounter *counters)
+{
+	for (int i = 1; i < BURST_TOP_NUM; i++) {
+		BurstCounter c = counters[i];
+		int j = i - 1;
+		while (j >= 0 && counters[j].bytes < c.bytes) {
+			counters[j + 1] = counters[j];
+			j--;
+		}
+		counters[j + 1] = c;
+	}
+}
+
+BurstDetector::BurstDetector()
+{
+	window_ = 0.0001;	//100us
+	thresh_bytes_ = 0;
+	rate_thresh_ = 0;
+	bursts_ = 0;
+
+	for (int i = 0; i < BURST_WINDOW_BUCKETS; i++)
+		buckets[i] = 0;
+	cur = 0;
+	bucket_start = 0;
+	growth = 0;
+	last_occupancy = 0;
+
+	active = 0;
+	memset(&current, 0, sizeof(current));
+	memset(ring, 0, sizeof(ring));
+	ring_head = 0;
+}
+
+/* Expire buckets older than the window. At most BURST_WINDOW_BUCKETS steps */
+void BurstDetector::advance(double now)
+{
+	double width = window_ / BURST_WINDOW_BUCKETS;
+
+	if (width <= 0) {
+		bucket_start = now;
+		return;
+	}
+
+	for (int i = 0; i < BURST_WINDOW_BUCKETS && now >= bucket_start + width; i++) {
+		cur = (cur + 1) % BURST_WINDOW_BUCKETS;
+		growth -= buckets[cur];
+		buckets[cur] = 0;
+		bucket_start += width;
+	}
+
+	/* idle for more than a window */
+	if (now >= bucket_start + width)
+		bucket_start = now;
+}
+
+/* Return 1 if the occupancy or the growth rate exceeds threshold / divisor */
+int BurstDetector::above(int occupancy, int divisor)
+{
+	if (thresh_bytes_ > 0 && occupancy > thresh_bytes_ / divisor)
+		return 1;
+	if (rate_thresh_ > 0 && window_ > 0 && growth * 8 / window_ > rate_thresh_ / divisor)
+		return 1;
+
+	return 0;
+}
+
+void BurstDetector::update(double now, int occupancy)
+{
+	int delta = occupancy - last_occupancy;
+
+	advance(now);
+	buckets[cur] += delta;
+	growth += delta;
+	last_occupancy = occupancy;
+
+	if (!active && above(occupancy, 1)) {
+		active = 1;
+		memset(&current, 0, sizeof(current));
+		for (int i = 0; i < BURST_TOP_NUM; i++) {
+			current.queues[i].id = -1;
+			current.flows[i].id = -1;
+		}
+		current.start = now;
+	} else if (active && !above(occupancy, 2)) {	//hysteresis
+		active = 0;
+		current.end = now;
+		SortCounters(current.queues);
+		SortCounters(current.flows);
+		ring[ring_head] = current;
+		ring_head = (ring_head + 1) % BURST_RING_SIZE;
+		bursts_++;
+	}
+
+	if (active && occupancy > current.peak) {
+		current.peak = occupancy;
+		current.peak_time = now;
+	}
+}
+
+void BurstDetector::enque(Packet *p, int queue_index, int occupancy)
+{
+	int pktSize = hdr_cmn::access(p)->size();
+
+	update(Scheduler::instance().clock(), occupancy);
+
+	if (active) {
+		current.bytes += pktSize;
+		SpaceSaving(current.queues, queue_index, pktSize);
+		SpaceSaving(current.flows, hdr_ip::access(p)->flowid(), pktSize);
+	}
+}
+
+void BurstDetector::deque(int occupancy)
+{
+	update(Scheduler::instance().clock(), occupancy);
+}
+
+/*
+ * Write one burst record. The line is
+ * start, end, peak time, peak bytes, bytes, queues id:bytes ..., flows id:bytes ...
+ */
+static void WriteRecord(Tcl_Channel chan, BurstRecord *r)
+{
+	char wrk[500] = {0};
+	int len = sprintf(wrk, "%.9f, %.9f, %.9f, %d, %d, queues",
+			  r->start, r->end, r->peak_time, r->peak, r->bytes);
+
+	for (int j = 0; j < BURST_TOP_NUM && r->queues[j].bytes > 0; j++)
+		len += sprintf(wrk + len, " %d:%d", r->queues[j].id, r->queues[j].bytes);
+	len += sprintf(wrk + len, ", flows");
+	for (int j = 0; j < BURST_TOP_NUM && r->flows[j].bytes > 0; j++)
+		len += sprintf(wrk + len, " %d:%d", r->flows[j].id, r->flows[j].bytes);
+	len += sprintf(wrk + len, "\n");
+
+	Tcl_Write(chan, wrk, len);
+}
+
+/*
+ * Write completed bursts, oldest first, then the burst in progress, if
+ * any, with now as its end. The burst in progress is not closed.
+ */
+int BurstDetector::dump(Tcl_Channel chan)
+{
+	int num = (bursts_ < BURST_RING_SIZE) ? bursts_ : BURST_RING_SIZE;
+
+	for (int i = 0; i < num; i++)
+		WriteRecord(chan, &ring[(ring_head - num + i + BURST_RING_SIZE) % BURST_RING_SIZE]);
+
+	if (active) {
+		BurstRecord r = current;
+		r.end = Scheduler::instance().clock();
+		SortCounters(r.queues);
+		SortCounters(r.flows);
+		WriteRecord(chan, &r);
+		num++;
+	}
+
+	return num;
+}
@@ -0,0 +1,68 @@
+#ifndef ns_burst_detector_h
+#define ns_burst_detector_h
+
+#include "queue.h"
+#include "config.h"
+
+/* Number of buckets of the sliding window */
+#define BURST_WINDOW_BUCKETS 8
+/* Number of queues and flows reported per burst */
+#define BURST_TOP_NUM 4
+/* Number of burst records kept */
+#define BURST_RING_SIZE 64
+
+/* Space-Saving counter of bytes per queue or per flow */
+struct BurstCounter
+{
+	int id;
+	int bytes;
+};
+
+struct BurstRecord
+{
+	double start;	//time when the burst starts
+	double end;	//time when the burst ends
+	double peak_time;	//time of the peak occupancy
+	int peak;	//peak occupancy in bytes
+	int bytes;	//bytes enqueued during the burst
+	BurstCounter queues[BURST_TOP_NUM];	//top contributing queues
+	BurstCounter flows[BURST_TOP_NUM];	//top contributing flows
+};
+
+/*
+ * Microburst detector shared by switch schedulers. It tracks the growth of
+ * the buffer occupancy over a sliding window. A burst starts when either the
+ * occupancy or the growth rate exceeds its threshold, and ends when both fall
+ * below half of the thresholds. Per-packet work is constant.
+ */
+class BurstDetector
+{
+	public:
+		BurstDetector();
+		void enque(Packet *p, int queue_index, int occupancy);	//after a packet is enqueued
+		void deque(int occupancy);	//after a packet leaves the buffer
+		int dump(Tcl_Channel chan);	//write burst records, the one in progress last
+
+		double window_;	//length of the sliding window (s)
+		int thresh_bytes_;	//occupancy threshold in bytes (0 to disable)
+		double rate_thresh_;	//growth rate threshold in bps (0 to disable)
+		int bursts_;	//number of bursts detected
+
+	protected:
+		void advance(double now);	//expire old buckets
+		void update(double now, int occupancy);
+		int above(int occupancy, int divisor);
+
+		int buckets[BURST_WINDOW_BUCKETS];	//occupancy change in each bucket
+		int cur;	//current bucket
+		double bucket_start;	//start time of the current bucket
+		int growth;	//occupancy change in the window
+		int last_occupancy;
+
+		int active;	//in a burst or not
+		BurstRecord current;	//the burst in progress
+		BurstRecord ring[BURST_RING_SIZE];	//completed bursts
+		int ring_head;	//next record to write
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <float.h>
 #include <math.h>
 #include "flags.h"
+#include "tcp.h"
 #include "prio_dwrr.h"
 
 #define max(arg1,arg2) (arg1>arg2 ? arg1 : arg2)
@@ -28,6 +29,31 @@ static void InsertTailList(PacketDWRR* list, PacketDWRR *q)
 	}
 }
 
+/* Remove a queue from an active list */
+static void RemoveEntryList(PacketDWRR* list, PacketDWRR *q)
+{
+	if (!list || !q)
+		return;
+
+	PacketDWRR* tmp = list;
+	while (tmp->next) {
+		if (tmp->next == q) {
+			tmp->next = q->next;
+			q->next = NULL;
+			return;
+		}
+		tmp = tmp->next;
+	}
+}
+
+/* Hash a flow to a bucket of the switch-side PIAS flow table */
+static unsigned int MlfqHash(int fid, int src)
+{
+	unsigned int h = (unsigned int)fid * 2654435761U;
+	h ^= (unsigned int)src * 40503U;
+	return (h ^ (h >> 16)) & (MLFQ_TABLE_SETS - 1);
+}
+
 /* Remove and return the head node from the active list */
 static PacketDWRR* RemoveHeadList(PacketDWRR* list)
 {
@@ -80,6 +106,23 @@ PRIO_DWRR::PRIO_DWRR()
 	mqecn_alpha_ = 0.75;
 	mqecn_interval_bytes_ = 1500;
 
+	mlfq_enable_ = 0;
+	mlfq_aging_time_ = 0;
+	for (int i = 0; i < MAX_PRIO_QUEUE_NUM; i++)
+		mlfq_thresh[i] = 0;
+	mlfq_thresh_set_ = 0;
+	mlfq_table = NULL;
+	mlfq_flows_ = 0;
+	mlfq_evictions_ = 0;
+
+	trim_enable_ = 0;
+	trim_headroom_ = 1;
+	trimmed_pkts_ = 0;
+
+	burst_enable_ = 0;
+	int_enable_ = 0;
+	int_tx_bytes_ = 0;
+
 	total_qlen_tchan_ = NULL;
 	qlen_tchan_ = NULL;
 
@@ -95,6 +138,25 @@ PRIO_DWRR::PRIO_DWRR()
 
 	bind("mqecn_alpha_", &mqecn_alpha_);
 	bind("mqecn_interval_bytes_", &mqecn_interval_bytes_);
+
+	bind_bool("mlfq_enable_", &mlfq_enable_);
+	bind_time("mlfq_aging_time_", &mlfq_aging_time_);
+	bind("mlfq_flows_", &mlfq_flows_);
+	bind("mlfq_evictions_", &mlfq_evictions_);
+
+	bind_bool("trim_enable_", &trim_enable_);
+	bind("trim_headroom_", &trim_headroom_);
+	bind("trimmed_pkts_", &trimmed_pkts_);
+
+	bind("pushout_policy_", &pushout_policy_);
+	bind("pushouts_", &pushouts_);
+
+	bind_bool("burst_enable_", &burst_enable_);
+	bind_time("burst_window_", &burst.window_);
+	bind("burst_thresh_bytes_", &burst.thresh_bytes_);
+	bind_bw("burst_rate_thresh_", &burst.rate_thresh_);
+	bind("bursts_", &burst.bursts_);
+	bind_bool("int_enable_", &int_enable_);
 }
 
 PRIO_DWRR::~PRIO_DWRR()
@@ -102,6 +164,7 @@ PRIO_DWRR::~PRIO_DWRR()
 	delete active;
 	delete [] prio_queues;
 	delete [] dwrr_queues;
+	delete [] mlfq_table;
 }
 
 /* Get total length of all DWRR queues in bytes */
@@ -192,8 +255,11 @@ int PRIO_DWRR::ecn_mark(int queue_index)
  *  entry points from OTcL to set per queue state variables
  *   - $q set-quantum queue_id queue_quantum (quantum is actually weight)
  *   - $q set-thresh queue_id queue_thresh
+ *   - $q set-mlfq-thresh queue_id bytes (switch-side PIAS demotion threshold)
+ *   - $q set-protect queue_id queue_protect (pkts protected from pushout)
  *   - $q attach-total file
  *   - $q attach-queue file
+ *   - $q dump-bursts file
  *
  *  NOTE: $q represents the discipline queue variable in OTcl.
  */
@@ -219,6 +285,15 @@ int PRIO_DWRR::command(int argc, const char*const* argv)
 				return (TCL_ERROR);
 			}
 			return (TCL_OK);
+
+		} else if (strcmp(argv[1], "dump-bursts") == 0) {	//microburst records
+			Tcl_Channel chan = Tcl_GetChannel(tcl.interp(), (char*)id, &mode);
+			if (chan == 0) {
+				tcl.resultf("Cannot attach %s for writing", id);
+				return (TCL_ERROR);
+			}
+			burst.dump(chan);
+			return (TCL_OK);
 		}
 	} else if (argc == 4) {
 		if (strcmp(argv[1], "set-quantum") == 0) {	//only for WFQ queues
@@ -245,6 +320,35 @@ int PRIO_DWRR::command(int argc, const char*const* argv)
                                 fprintf(stderr, "Invalid set-thresh params: %s %s\n", argv[2], argv[3]);
 				exit(1);
 			}
+		} else if (strcmp(argv[1], "set-protect") == 0) {	//for all the queues
+			int index = atoi(argv[2]);
+			double protect = atof(argv[3]);
+
+			if (index < prio_queue_num_ + dwrr_queue_num_ && index >= 0 && protect >= 0) {
+				if (index < prio_queue_num_)
+					prio_queues[index].protect = protect;
+				else
+					dwrr_queues[index - prio_queue_num_].protect = protect;
+				return (TCL_OK);
+			} else {
+				fprintf(stderr, "Invalid set-protect params: %s %s\n", argv[2], argv[3]);
+				exit(1);
+			}
+		} else if (strcmp(argv[1], "set-mlfq-thresh") == 0) {	//only for strict priority queues
+			int index = atoi(argv[2]);
+			double thresh = atof(argv[3]);
+
+			if (index < MAX_PRIO_QUEUE_NUM && index >= 0 && thresh >= 0) {
+				mlfq_thresh[index] = thresh;
+				mlfq_thresh_set_ = 0;
+				for (int i = 0; i < MAX_PRIO_QUEUE_NUM; i++)
+					if (mlfq_thresh[i] > 0)
+						mlfq_thresh_set_ = 1;
+				return (TCL_OK);
+			} else {
+				fprintf(stderr, "Invalid set-mlfq-thresh params: %s %s\n", argv[2], argv[3]);
+				exit(1);
+			}
 		}
 	}
 	return (Queue::command(argc, argv));
@@ -271,6 +375,145 @@ void PRIO_DWRR::reset_roundtime()
 	}
 }
 
+/*
+ * Find the flow table entry of a packet. Entries of the bucket idle for
+ * longer than mlfq_aging_time_ are freed on the way. If the flow is not in
+ * the table, take a free entry, and evict the least recently used flow of
+ * the bucket as the last resort.
+ */
+MlfqFlow* PRIO_DWRR::mlfq_lookup(Packet *pkt, double now)
+{
+	hdr_ip *iph = hdr_ip::access(pkt);
+	int fid = iph->flowid();
+	int src = iph->saddr();
+	MlfqFlow *bucket = NULL;
+	MlfqFlow *victim = NULL;
+
+	if (!mlfq_table) {
+		mlfq_table = new MlfqFlow[MLFQ_TABLE_SETS * MLFQ_TABLE_WAYS];
+		memset(mlfq_table, 0, sizeof(MlfqFlow) * MLFQ_TABLE_SETS * MLFQ_TABLE_WAYS);
+	}
+
+	bucket = &mlfq_table[MlfqHash(fid, src) * MLFQ_TABLE_WAYS];
+	for (int i = 0; i < MLFQ_TABLE_WAYS; i++) {
+		MlfqFlow *e = &bucket[i];
+		/* The flow has been idle for too long, it starts over if it comes back */
+		if (e->valid && mlfq_aging_time_ > 0 && now - e->last_time > mlfq_aging_time_) {
+			e->valid = 0;
+			mlfq_flows_--;
+		}
+		if (e->valid && e->fid == fid && e->src == src) {
+			e->last_time = now;
+			return e;
+		}
+
+		if (!e->valid) {
+			if (!victim || victim->valid)
+				victim = e;
+		} else if (!victim || (victim->valid && e->last_time < victim->last_time)) {
+			victim = e;
+		}
+	}
+
+	if (!victim->valid)
+		mlfq_flows_++;
+	else
+		mlfq_evictions_++;
+
+	victim->valid = 1;
+	victim->fid = fid;
+	victim->src = src;
+	victim->bytes = 0;
+	victim->last_time = now;
+	return victim;
+}
+
+/*
+ * Switch-side PIAS: demote a flow through the strict priority queues based on
+ * the bytes it has sent. A flow never gets a higher priority than its host tag.
+ * Once a flow exceeds all the thresholds, it goes to its DWRR queue (or the first
+ * DWRR queue if the host tags it with a strict priority).
+ */
+int PRIO_DWRR::mlfq_classify(Packet *pkt, int queue_index, double now)
+{
+	MlfqFlow *e = mlfq_lookup(pkt, now);
+	int level = prio_queue_num_;
+
+	for (int i = 0; i < prio_queue_num_; i++) {
+		if (e->bytes < mlfq_thresh[i]) {
+			level = i;
+			break;
+		}
+	}
+	e->bytes += hdr_cmn::access(pkt)->size();
+
+	if (level < prio_queue_num_)
+		return max(level, queue_index);
+	else if (queue_index >= prio_queue_num_)
+		return queue_index;
+	else
+		return prio_queue_num_;
+}
+
+/*
+ * Packet trimming: cut the payload of a TCP data packet, leaving the header.
+ * The header is retagged with the highest priority for all the next hops.
+ * Return 1 if the packet is (or was already) header-only.
+ */
+int PRIO_DWRR::trim(Packet *pkt)
+{
+	hdr_cmn* hc = hdr_cmn::access(pkt);
+	hdr_tcp* tcph = hdr_tcp::access(pkt);
+
+	if (tcph->trimmed())
+		return 1;
+	if (hc->ptype() != PT_TCP || hc->size() <= tcph->hlen())
+		return 0;
+
+	hc->size() = tcph->hlen();
+	tcph->trimmed() = 1;
+	hdr_ip::access(pkt)->prio() = 0;
+	trimmed_pkts_++;
+	return 1;
+}
+
+PacketQueue* PRIO_DWRR::get_queue(int queue_index)
+{
+	if (queue_index < prio_queue_num_)
+		return &prio_queues[queue_index];
+	else
+		return &dwrr_queues[queue_index - prio_queue_num_];
+}
+
+/* Packets below this length (bytes) of queue 'index' are never pushed out */
+int PRIO_DWRR::pushout_protect(int index)
+{
+	if (index < prio_queue_num_)
+		return (int)(prio_queues[index].protect * mean_pktsize_);
+	else
+		return (int)(dwrr_queues[index - prio_queue_num_].protect * mean_pktsize_);
+}
+
+/* Evict the tail packet of a queue, keeping the DWRR active list consistent */
+void PRIO_DWRR::pushout_tail(int index)
+{
+	PacketQueue *q = get_queue(index);
+	Packet *pkt = q->tail();
+
+	q->remove(pkt);
+	pushouts_++;
+
+	if (index >= prio_queue_num_ && q->length() == 0) {
+		PacketDWRR *node = &dwrr_queues[index - prio_queue_num_];
+		RemoveEntryList(active, node);
+		node->deficit = 0;
+		if (dwrr_bytelength() == 0)
+			last_idle_time = Scheduler::instance().clock();
+	}
+
+	drop(pkt);
+}
+
 /* Receive a new packet */
 void PRIO_DWRR::enque(Packet *p)
 {
@@ -287,16 +530,34 @@ void PRIO_DWRR::enque(Packet *p)
 
 	reset_roundtime();
 
-	/* The shared buffer is overfilld */
-	if (total_bytelength() + pktSize > qlimBytes) {
-		drop(p);
-		//printf("Packet drop\n");
-		return;
-	}
-
 	if (prio >= queue_num_ || prio < 0)
 		prio = queue_num_ - 1;
 
+	/*
+	 * Switch-side PIAS. Retag the packet so that downstream switches follow.
+	 * Without any set-mlfq-thresh, trust the host tags.
+	 */
+	if (mlfq_enable_ && mlfq_thresh_set_ && !hdr_tcp::access(p)->trimmed()) {
+		prio = mlfq_classify(p, prio, now);
+		iph->prio() = prio;
+	}
+
+	/* The shared buffer is overfilld and we cannot push out other packets */
+	if (total_bytelength() + pktSize > qlimBytes &&
+	    !pushout(prio, pktSize, total_bytelength() + pktSize - qlimBytes)) {
+		/* Packet trimming: keep the header within the headroom */
+		if (!trim_enable_ || !trim(p) ||
+		    total_bytelength() + hc->size() > qlimBytes + trim_headroom_ * mean_pktsize_) {
+			drop(p);
+			//printf("Packet drop\n");
+			return;
+		}
+	}
+
+	/* Trimmed headers always go to the highest priority queue */
+	if (trim_enable_ && hdr_tcp::access(p)->trimmed())
+		prio = 0;
+
 	if (prio < prio_queue_num_) {	//strict higher priority queues
 		prio_queues[prio].enque(p);
 	} else {	//WFQ queues in the lowest priority
@@ -315,6 +576,9 @@ void PRIO_DWRR::enque(Packet *p)
 	/* For TCN ,record enqueue timestamp here */
 	else if (marking_scheme_ == TCN_MARKING && hf->ect())
 	        hc->timestamp() = now;
+
+	if (burst_enable_)
+		burst.enque(p, prio, total_bytelength());
 }
 
 void PRIO_DWRR::tcn_mark(Packet *pkt)
@@ -339,6 +603,25 @@ void PRIO_DWRR::tcn_mark(Packet *pkt)
         hc->timestamp() = 0;
 }
 
+/*
+ * INT: count the bytes the port sends, and append a record of this hop
+ * to packets that ask for one. The queue length excludes the packet.
+ */
+void PRIO_DWRR::int_stamp(Packet *pkt)
+{
+	hdr_tcp *tcph = hdr_tcp::access(pkt);
+
+	int_tx_bytes_ += hdr_cmn::access(pkt)->size();
+	if (!tcph->int_on() || tcph->int_nhop() >= MAX_INT_HOPS)
+		return;
+
+	IntHop& hop = tcph->int_hop(tcph->int_nhop()++);
+	hop.ts = Scheduler::instance().clock();
+	hop.txbytes = int_tx_bytes_;
+	hop.rate = link_capacity_;
+	hop.qlen = total_bytelength();
+}
+
 Packet *PRIO_DWRR::deque(void)
 {
 	PacketDWRR *headNode = NULL;
@@ -360,6 +643,10 @@ Packet *PRIO_DWRR::deque(void)
 				pkt = prio_queues[i].deque();
                                 if (marking_scheme_ == TCN_MARKING)
                                         tcn_mark(pkt);
+				if (int_enable_)
+					int_stamp(pkt);
+				if (burst_enable_)
+					burst.deque(total_bytelength());
 
                                 return pkt;
 			}
@@ -383,6 +670,8 @@ Packet *PRIO_DWRR::deque(void)
 			/* TCN marking */
 			if (marking_scheme_ == TCN_MARKING)
 				tcn_mark(pkt);
+			if (int_enable_)
+				int_stamp(pkt);
 
 			/* After dequeue, headNode becomes empty */
 			if (headNode->length() == 0) {
@@ -416,6 +705,9 @@ Packet *PRIO_DWRR::deque(void)
 	if (dwrr_bytelength() == 0)
 		last_idle_time = now;
 
+	if (burst_enable_)
+		burst.deque(total_bytelength());
+
 	return pkt;
 }
 
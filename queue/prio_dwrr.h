@@ -5,9 +5,11 @@
 #include "config.h"
 #include "trace.h"
 #include "timer-handler.h"
+#include "burst_detector.h"
+#include "pushout.h"
 
 /* Maximum number of strict higher priority queues */
-#define MAX_PRIO_QUEUE_NUM 8
+#define MAX_PRIO_QUEUE_NUM 16
 /* Maximum number of DWRR queues in the lowest priority */
 #define MAX_DWRR_QUEUE_NUM 64
 
@@ -24,6 +26,10 @@
 #define PRIO_QUEUE 0
 #define DWRR_QUEUE 1
 
+/* Switch-side PIAS flow table: MLFQ_TABLE_SETS buckets of MLFQ_TABLE_WAYS entries */
+#define MLFQ_TABLE_SETS 1024
+#define MLFQ_TABLE_WAYS 4
+
 class PacketPRIO;
 class PacketDWRR;
 class PRIO_DWRR;
@@ -31,10 +37,11 @@ class PRIO_DWRR;
 class PacketPRIO: public PacketQueue
 {
 	public:
-		PacketPRIO(): thresh(0) {}
+		PacketPRIO(): thresh(0), protect(0) {}
 
 		int id;	//priority queue ID
 		double thresh;	//per-queue ECN marking threshold (pkts)
+		double protect;	//never push out packets below this length (pkts)
 
 		friend class PRIO_DWRR;
 };
@@ -42,10 +49,11 @@ class PacketPRIO: public PacketQueue
 class PacketDWRR: public PacketQueue
 {
 	public:
-		PacketDWRR(): thresh(0), quantum(1500), deficit(0), start_time(0), next(NULL) {}
+		PacketDWRR(): thresh(0), protect(0), quantum(1500), deficit(0), start_time(0), next(NULL) {}
 
 		int id;
                 double thresh;	// per-queue ECN marking threshold (pkts)
+		double protect;	// never push out packets below this length (pkts)
 		int quantum;	// quantum of this queue
 		int deficit;	// deficit counter for this queue
 		double start_time;	// time when this queue is inserted to active list
@@ -54,7 +62,17 @@ class PacketDWRR: public PacketQueue
 		friend class PRIO_DWRR;
 };
 
-class PRIO_DWRR : public Queue
+/* An entry of the switch-side PIAS flow table */
+struct MlfqFlow
+{
+	int valid;	// whether this entry is in use
+	int fid;	// flow ID
+	int src;	// source address
+	int bytes;	// bytes of this flow seen so far
+	double last_time;	// last time when this flow sends a packet
+};
+
+class PRIO_DWRR : public PushoutQueue
 {
 	public:
 		PRIO_DWRR();
@@ -70,6 +88,14 @@ class PRIO_DWRR : public Queue
 		int ecn_mark(int queue_index);	//queue length ECN marking
 		void tcn_mark(Packet *pkt);	//our solution: TCN
 		void reset_roundtime();	//reset round time of MQ-ECN
+		MlfqFlow* mlfq_lookup(Packet *pkt, double now);	//find (or allocate) flow table entry
+		int mlfq_classify(Packet *pkt, int queue_index, double now);	//switch-side PIAS
+		int trim(Packet *pkt);	//cut the payload of a packet
+		PacketQueue* get_queue(int queue_index);	//map a queue index to its queue
+		int pushout_queue_num() { return (prio_queue_num_ + dwrr_queue_num_); }
+		int pushout_prio_num() { return (prio_queue_num_); }
+		int pushout_protect(int index);	//protected length of a queue in bytes
+		void pushout_tail(int index);	//evict the tail packet of a queue
 
 		PacketPRIO *prio_queues;	//strict higher priority queues
 		PacketDWRR *dwrr_queues;	//DWRR queues in the lowest priority
@@ -90,6 +116,31 @@ class PRIO_DWRR : public Queue
 		double mqecn_alpha_;	//alpha for MQ-ECN
 		int mqecn_interval_bytes_;	//interval (divided by link capacity) for MQ-ECN
 
+		// Switch-side PIAS
+		int mlfq_enable_;	//demote flows by bytes sent (true) or trust host tags (false)
+		double mlfq_aging_time_;	//entries idle for longer than this start over
+		double mlfq_thresh[MAX_PRIO_QUEUE_NUM];	//a flow stays in queue i while it sent < mlfq_thresh[i] bytes
+		int mlfq_thresh_set_;	//any mlfq_thresh set (false: trust host tags even if mlfq_enable_)
+		MlfqFlow *mlfq_table;	//flow table, allocated on first use
+		int mlfq_flows_;	//number of occupied flow table entries (aged ones are freed on lookup of their bucket)
+		int mlfq_evictions_;	//number of live flows evicted from flow table
+
+		// Packet trimming
+		int trim_enable_;	//trim packets (true) or drop them (false) when the buffer overflows
+		double trim_headroom_;	//extra buffer (pkts) reserved for trimmed headers
+		int trimmed_pkts_;	//number of packets trimmed
+
+		// Pushout
+
+		// Microburst detection
+		int burst_enable_;	//detect microbursts (true) or not (false)
+		BurstDetector burst;
+
+		// In-band network telemetry
+		int int_enable_;	//stamp INT records on departing packets (true) or not (false)
+		double int_tx_bytes_;	//bytes sent by this port
+		void int_stamp(Packet *pkt);	//count and stamp a departing packet
+
 		Tcl_Channel total_qlen_tchan_;        //place to write total_qlen records
 		Tcl_Channel qlen_tchan_;      //place to write per-queue qlen records
 		void trace_total_qlen();      //routine to write total qlen records
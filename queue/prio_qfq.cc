@@ -0,0 +1,546 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "flags.h"
+#include "prio_qfq.h"
+
+#define max(arg1,arg2) (arg1>arg2 ? arg1 : arg2)
+#define min(arg1,arg2) (arg1<arg2 ? arg1 : arg2)
+
+/* Position of the most significant bit set (1-based), 0 if x is 0 */
+static int QfqFls(qfq_time_t x)
+{
+	int result = 0;
+
+	while (x) {
+		x >>= 1;
+		result++;
+	}
+	return result;
+}
+
+/* Wrap-around safe comparison of virtual times: return true if a > b */
+static inline int QfqGt(qfq_time_t a, qfq_time_t b)
+{
+	return (long long)(a - b) > 0;
+}
+
+static inline qfq_time_t QfqRoundDown(qfq_time_t ts, int shift)
+{
+	return ts & ~((1ULL << shift) - 1);
+}
+
+/*
+ * Index of the group of a queue: the slot size (max packet size / weight)
+ * is rounded up to a power of two, relative to QFQ_MIN_SLOT_SHIFT.
+ */
+static int QfqCalcIndex(qfq_time_t inv_w, int maxlen)
+{
+	qfq_time_t slot_size = (qfq_time_t)maxlen * inv_w;
+	qfq_time_t size_map = slot_size >> QFQ_MIN_SLOT_SHIFT;
+	int index = 0;
+
+	if (!size_map)
+		return 0;
+
+	index = QfqFls(size_map);
+	/* the slot size is exactly a power of two */
+	if (slot_size == (1ULL << (index + QFQ_MIN_SLOT_SHIFT - 1)))
+		index--;
+
+	return min(index, QFQ_MAX_INDEX);
+}
+
+static class PrioQfqClass : public TclClass
+{
+	public:
+		PrioQfqClass() : TclClass("Queue/PrioQfq") {}
+		TclObject* create(int argc, const char*const* argv)
+		{
+			return (new PRIO_QFQ);
+		}
+} class_prio_qfq;
+
+PRIO_QFQ::PRIO_QFQ()
+{
+	prio_queues = new PacketQfqPRIO[MAX_PRIO_QUEUE_NUM];
+	qfq_queues = NULL;	//allocated when the number of queues is known
+	groups = new QfqGroup[QFQ_MAX_INDEX + 1];
+
+	for (int i = 0; i <= QFQ_MAX_INDEX; i++)
+		groups[i].slot_shift = i + QFQ_MIN_SLOT_SHIFT;
+
+	active_groups = 0;
+	V = 0;
+	wsum = 0;
+	prio_bytes = 0;
+	qfq_bytes = 0;
+	qfq_queue_alloc = 0;
+	slot_clamped = 0;
+
+	prio_queue_num_ = 1;
+	qfq_queue_num_ = 7;
+	mean_pktsize_ = 1500;
+	port_thresh_ = 65;
+	marking_scheme_ = PER_QUEUE_MARKING;
+	link_capacity_ = 10000000000;	//10Gbps
+	debug_ = 0;
+
+	total_qlen_tchan_ = NULL;
+	qlen_tchan_ = NULL;
+
+	/* bind variables */
+	bind("prio_queue_num_", &prio_queue_num_);
+	bind("qfq_queue_num_", &qfq_queue_num_);
+	bind("mean_pktsize_", &mean_pktsize_);
+	bind("port_thresh_", &port_thresh_);
+	bind("marking_scheme_", &marking_scheme_);
+	bind_bw("link_capacity_", &link_capacity_);
+	bind_bool("debug_", &debug_);
+}
+
+PRIO_QFQ::~PRIO_QFQ()
+{
+	delete [] prio_queues;
+	delete [] qfq_queues;
+	delete [] groups;
+}
+
+/*
+ * Allocate QFQ queues on first use, since a spine port may carry thousands
+ * of them. Later changes to qfq_queue_num_ cannot exceed this allocation.
+ */
+void PRIO_QFQ::init_queues()
+{
+	if (qfq_queues)
+		return;
+
+	qfq_queue_alloc = max(min(qfq_queue_num_, MAX_QFQ_QUEUE_NUM), 1);
+	qfq_queues = new PacketQFQ[qfq_queue_alloc];
+	wsum = 0;
+	for (int i = 0; i < qfq_queue_alloc; i++)
+		wsum += qfq_queues[i].weight;
+}
+
+/*
+ * Update the weight of a QFQ queue. A backlogged queue keeps the start time
+ * of its head packet, and is moved to the group and bucket of the new weight.
+ */
+void PRIO_QFQ::set_weight(PacketQFQ *q, int weight)
+{
+	weight = max(min(weight, QFQ_MAX_WEIGHT), 1);
+	wsum += weight - q->weight;
+	q->weight = weight;
+	q->inv_w = QFQ_ONE_FP / weight;
+
+	if (q->length() > 0) {
+		slot_remove(&groups[q->grp], q);
+		q->F = q->S + (qfq_time_t)hdr_cmn::access(q->head())->size() * q->inv_w;
+		group_insert(q);
+	}
+}
+
+/* Get total length of all queues in bytes */
+int PRIO_QFQ::total_bytelength()
+{
+	return prio_bytes + qfq_bytes;
+}
+
+/*
+ * queue-length ECN marking
+ * Return 1 if it the packet should gets marked
+ */
+int PRIO_QFQ::ecn_mark(int queue_index)
+{
+	int type = 0, index = 0;
+
+	if (queue_index < 0 || queue_index >= prio_queue_num_ + qfq_queue_num_) {
+		fprintf(stderr, "Invalid queue index value %d\n", queue_index);
+		exit(1);
+	}
+
+	if (queue_index < prio_queue_num_) {
+		index = queue_index;
+		type = PRIO_QUEUE;
+	} else {
+		index = queue_index - prio_queue_num_;
+		type = QFQ_QUEUE;
+	}
+
+	if (marking_scheme_ == PER_QUEUE_MARKING) {	//per-queue marking
+		if (type == PRIO_QUEUE &&
+		    prio_queues[index].byteLength() > prio_queues[index].thresh * mean_pktsize_)
+			return 1;
+		else if (type == QFQ_QUEUE &&
+			 qfq_queues[index].byteLength() > qfq_queues[index].thresh * mean_pktsize_)
+			return 1;
+		else
+			return 0;
+	} else if (marking_scheme_ == PER_PORT_MARKING) {	//per-port marking
+		if (total_bytelength() > port_thresh_ * mean_pktsize_)
+			return 1;
+		else
+			return 0;
+	} else {
+		fprintf(stderr, "Unknown ECN marking scheme %d\n", marking_scheme_);
+		return 0;
+	}
+}
+
+/*
+ *  entry points from OTcL to set per queue state variables
+ *  - $q set-weight queue_id queue_weight (1 to QFQ_MAX_WEIGHT)
+ *  - $q set-thresh queue_id queue_thresh
+ *  - $q attach-total file
+ *  - $q attach-queue file
+ *
+ *  NOTE: $q represents the discipline queue variable in OTcl.
+ */
+int PRIO_QFQ::command(int argc, const char*const* argv)
+{
+	if (argc == 3) {
+		int mode;
+		const char* id = argv[2];
+		Tcl& tcl = Tcl::instance();
+
+		if (strcmp(argv[1], "attach-total") == 0) {	//total queue length
+			total_qlen_tchan_ = Tcl_GetChannel(tcl.interp(), (char*)id, &mode);
+			if (total_qlen_tchan_ == 0) {
+				tcl.resultf("Cannot attach %s for writing", id);
+				return (TCL_ERROR);
+			}
+			return (TCL_OK);
+
+		} else if (strcmp(argv[1], "attach-queue") == 0) {	//per-queue queue length
+			qlen_tchan_ = Tcl_GetChannel(tcl.interp(), (char*)id, &mode);
+			if (qlen_tchan_ == 0) {
+				tcl.resultf("Cannot attach %s for writing", id);
+				return (TCL_ERROR);
+			}
+			return (TCL_OK);
+		}
+
+	} else if (argc == 4) {
+		init_queues();
+
+		if (strcmp(argv[1], "set-weight") == 0) {	//only for QFQ queues
+			int index = atoi(argv[2]) - prio_queue_num_;	//index of QFQ
+			int weight = atoi(argv[3]);	//QFQ queue weight
+			if (index < qfq_queue_alloc && index >= 0 && weight > 0 && weight <= QFQ_MAX_WEIGHT) {
+				set_weight(&qfq_queues[index], weight);
+				return (TCL_OK);
+			} else {
+				fprintf(stderr, "Invalid set-weight params: %s %s\n", argv[2], argv[3]);
+				exit(1);
+			}
+
+		} else if (strcmp(argv[1], "set-thresh") == 0) {	//for all the queues
+			int index = atoi(argv[2]);
+			double thresh = atof(argv[3]);
+			if (index < prio_queue_num_ + qfq_queue_alloc && index >= 0 && thresh >= 0) {
+				if (index < prio_queue_num_)
+					prio_queues[index].thresh = thresh;
+				else
+					qfq_queues[index - prio_queue_num_].thresh = thresh;
+				return (TCL_OK);
+
+			} else {
+				fprintf(stderr, "Invalid set-thresh params: %s %s\n", argv[2], argv[3]);
+				exit(1);
+			}
+		}
+	}
+	return (Queue::command(argc, argv));
+}
+
+/* Insert a backlogged queue to the bucket of its rounded start time */
+void PRIO_QFQ::slot_insert(QfqGroup *grp, PacketQFQ *q)
+{
+	qfq_time_t roundedS = QfqRoundDown(q->S, grp->slot_shift);
+	int slot = 0;
+	int index = 0;
+
+	if (QfqGt(grp->S, roundedS)) {
+		/*
+		 * The queue starts before the front bucket: rotate the buckets
+		 * backward, as far as the non-empty buckets at the back allow
+		 */
+		qfq_time_t shift = (grp->S - roundedS) >> grp->slot_shift;
+		int room = QFQ_MAX_SLOTS - QfqFls(grp->full_slots);
+		int i = (shift < (qfq_time_t)room) ? (int)shift : room;
+
+		grp->full_slots = (i < QFQ_MAX_SLOTS) ? grp->full_slots << i : 0;
+		grp->front = (grp->front - i + QFQ_MAX_SLOTS) % QFQ_MAX_SLOTS;
+		grp->S -= (qfq_time_t)i << grp->slot_shift;
+		grp->F = grp->S + (2ULL << grp->slot_shift);
+	} else {
+		qfq_time_t offset = (roundedS - grp->S) >> grp->slot_shift;
+		slot = (offset < QFQ_MAX_SLOTS - 1) ? (int)offset : QFQ_MAX_SLOTS - 1;
+		/* QFQ bounds the offset; beyond the buckets the order is no longer exact */
+		if (offset >= QFQ_MAX_SLOTS && !slot_clamped) {
+			fprintf(stderr, "PRIO_QFQ: queue %d starts %llu slots ahead of group %d, "
+				"beyond %d buckets; check the weights and mean_pktsize_\n",
+				(int)(q - qfq_queues) + prio_queue_num_, offset,
+				(int)(grp - groups), QFQ_MAX_SLOTS);
+			slot_clamped = 1;
+		}
+	}
+
+	index = (grp->front + slot) % QFQ_MAX_SLOTS;
+	q->next = grp->slots[index];
+	grp->slots[index] = q;
+	grp->full_slots |= 1U << slot;
+}
+
+/* Remove a backlogged queue from its bucket */
+void PRIO_QFQ::slot_remove(QfqGroup *grp, PacketQFQ *q)
+{
+	for (int slot = 0; slot < QFQ_MAX_SLOTS; slot++) {
+		int index = (grp->front + slot) % QFQ_MAX_SLOTS;
+		PacketQFQ **pp = &grp->slots[index];
+
+		while (*pp && *pp != q)
+			pp = &(*pp)->next;
+		if (!*pp)
+			continue;
+
+		*pp = q->next;
+		q->next = NULL;
+		if (!grp->slots[index])
+			grp->full_slots &= ~(1U << slot);
+		group_update(grp);
+		return;
+	}
+}
+
+/*
+ * After a bucket becomes empty: deactivate the group if it has no more
+ * queues, or move its front to the first non-empty bucket
+ */
+void PRIO_QFQ::group_update(QfqGroup *grp)
+{
+	int i = 0;
+
+	if (!grp->full_slots) {
+		active_groups &= ~(1U << (grp - groups));
+		return;
+	}
+
+	while (!(grp->full_slots & (1U << i)))
+		i++;
+	grp->front = (grp->front + i) % QFQ_MAX_SLOTS;
+	grp->full_slots >>= i;
+	grp->S += (qfq_time_t)i << grp->slot_shift;
+	grp->F = grp->S + (2ULL << grp->slot_shift);
+}
+
+/* A QFQ queue becomes backlogged: timestamp its head packet and insert it to its group */
+void PRIO_QFQ::activate(PacketQFQ *q)
+{
+	int len = hdr_cmn::access(q->head())->size();
+
+	/* A queue which has been idle starts from the system virtual time */
+	q->S = QfqGt(q->F, V) ? q->F : V;
+	q->F = q->S + (qfq_time_t)len * q->inv_w;
+	group_insert(q);
+}
+
+/* Insert a timestamped queue to the group of its weight */
+void PRIO_QFQ::group_insert(PacketQFQ *q)
+{
+	QfqGroup *grp = NULL;
+
+	q->grp = QfqCalcIndex(q->inv_w, mean_pktsize_);
+	grp = &groups[q->grp];
+
+	if (!(active_groups & (1U << q->grp))) {
+		grp->S = QfqRoundDown(q->S, grp->slot_shift);
+		grp->F = grp->S + (2ULL << grp->slot_shift);
+		grp->front = 0;
+		grp->full_slots = 0;
+		active_groups |= 1U << q->grp;
+	}
+
+	slot_insert(grp, q);
+}
+
+/*
+ * Select the eligible group (start time <= V) with the earliest finish time.
+ * If no group is eligible, V jumps to the earliest start time first. The cost
+ * is bounded by the number of groups, regardless of the number of queues.
+ */
+QfqGroup* PRIO_QFQ::select_group()
+{
+	QfqGroup *result = NULL;
+	QfqGroup *earliest = NULL;
+
+	for (int pass = 0; pass < 2 && !result; pass++) {
+		for (int i = 0; i <= QFQ_MAX_INDEX; i++) {
+			if (!(active_groups & (1U << i)))
+				continue;
+
+			QfqGroup *grp = &groups[i];
+			if (!earliest || QfqGt(earliest->S, grp->S))
+				earliest = grp;
+			if (!QfqGt(grp->S, V) && (!result || QfqGt(result->F, grp->F)))
+				result = grp;
+		}
+
+		if (!result && earliest)
+			V = earliest->S;
+	}
+
+	return result;
+}
+
+/* Receive a new packet */
+void PRIO_QFQ::enque(Packet *p)
+{
+	hdr_ip *iph = hdr_ip::access(p);
+	int prio = iph->prio();
+	hdr_flags* hf = hdr_flags::access(p);
+	hdr_cmn* hc = hdr_cmn::access(p);
+	int pktSize = hc->size();
+	int qlimBytes = qlim_ * mean_pktsize_;
+
+	init_queues();
+	qfq_queue_num_ = max(min(qfq_queue_num_, qfq_queue_alloc), 1);
+	prio_queue_num_ = max(min(prio_queue_num_, MAX_PRIO_QUEUE_NUM), 1);
+	int queue_num_ = qfq_queue_num_ + prio_queue_num_;
+
+	/* the shared buffer is overfilld */
+	if (total_bytelength() + pktSize > qlimBytes) {
+		drop(p);
+		return;
+	}
+
+	if (prio >= queue_num_ || prio < 0)
+		prio = queue_num_ - 1;
+
+	if (prio < prio_queue_num_) {	//strict higher priority queues
+		prio_queues[prio].enque(p);
+		prio_bytes += pktSize;
+	} else {	//QFQ queues in the lowest priority
+		PacketQFQ *q = &qfq_queues[prio - prio_queue_num_];
+		q->enque(p);
+		qfq_bytes += pktSize;
+		if (q->length() == 1)
+			activate(q);
+	}
+
+	/* Enqueue ECN marking */
+	if (marking_scheme_ != TCN_MARKING && ecn_mark(prio) > 0 && hf->ect())
+		hf->ce() = 1;
+	/* For TCN ,record enqueue timestamp here */
+	else if (marking_scheme_ == TCN_MARKING && hf->ect())
+		hc->timestamp() = Scheduler::instance().clock();
+}
+
+void PRIO_QFQ::tcn_mark(Packet *pkt)
+{
+	if (!pkt)
+		return;
+
+	hdr_flags* hf = hdr_flags::access(pkt);
+	hdr_cmn* hc = hdr_cmn::access(pkt);
+	double sojourn_time = Scheduler::instance().clock() - hc->timestamp();
+	double latency_thresh = 0;
+
+	if (link_capacity_ > 0)
+		latency_thresh = port_thresh_ * mean_pktsize_ * 8 / link_capacity_;
+
+	if (hf->ect() && sojourn_time > latency_thresh) {
+		hf->ce() = 1;
+		if (debug_)
+			printf("sojourn time %.9f > threshold %.9f\n", sojourn_time, latency_thresh);
+	}
+
+	hc->timestamp() = 0;
+}
+
+Packet* PRIO_QFQ::deque(void)
+{
+	Packet *pkt = NULL;
+
+	if (prio_bytes > 0) {
+		for (int i = 0; i < prio_queue_num_; i++) {
+			if (prio_queues[i].length() > 0) {
+				pkt = prio_queues[i].deque();
+				prio_bytes -= hdr_cmn::access(pkt)->size();
+				if (marking_scheme_ == TCN_MARKING)
+					tcn_mark(pkt);
+				break;
+			}
+		}
+	} else if (qfq_bytes > 0) {
+		QfqGroup *grp = select_group();
+		if (!grp || !grp->slots[grp->front]) {	//This should not happen!
+			fprintf(stderr, "not work conserving\n");
+			exit(1);
+		}
+
+		/* serve the head queue of the front bucket */
+		PacketQFQ *q = grp->slots[grp->front];
+		pkt = q->deque();
+		int len = hdr_cmn::access(pkt)->size();
+		qfq_bytes -= len;
+		V += (qfq_time_t)len * (QFQ_ONE_FP / wsum);
+		if (marking_scheme_ == TCN_MARKING)
+			tcn_mark(pkt);
+
+		grp->slots[grp->front] = q->next;
+		q->next = NULL;
+		if (!grp->slots[grp->front])
+			grp->full_slots &= ~1U;
+
+		/* timestamp the next packet of this queue and put it back */
+		if (q->length() > 0) {
+			q->S = q->F;
+			q->F = q->S + (qfq_time_t)hdr_cmn::access(q->head())->size() * q->inv_w;
+			slot_insert(grp, q);
+		}
+
+		group_update(grp);
+	}
+
+	trace_total_qlen();
+	trace_qlen();
+
+	return pkt;
+}
+
+/* routine to write total qlen records */
+void PRIO_QFQ::trace_total_qlen()
+{
+	if (!total_qlen_tchan_)
+		return;
+
+	char wrk[100] = {0};
+	sprintf(wrk, "%g, %d\n", Scheduler::instance().clock(), total_bytelength());
+	Tcl_Write(total_qlen_tchan_, wrk, strlen(wrk));
+}
+
+/* routine to write per-queue qlen records */
+void PRIO_QFQ::trace_qlen()
+{
+	if (!qlen_tchan_)
+		return;
+
+	char wrk[500] = {0};
+	sprintf(wrk, "%g", Scheduler::instance().clock());
+	Tcl_Write(qlen_tchan_, wrk, strlen(wrk));
+
+	for (int i = 0; i < prio_queue_num_; i++) {
+		sprintf(wrk, ", %d", prio_queues[i].byteLength());
+		Tcl_Write(qlen_tchan_, wrk, strlen(wrk));
+	}
+
+	for (int i = 0; i < qfq_queue_num_; i++) {
+		sprintf(wrk, ", %d", qfq_queues[i].byteLength());
+		Tcl_Write(qlen_tchan_, wrk, strlen(wrk));
+	}
+
+	Tcl_Write(qlen_tchan_, "\n", 1);
+}
@@ -0,0 +1,139 @@
+#ifndef ns_prio_qfq_h
+#define ns_prio_qfq_h
+
+#include "queue.h"
+#include "config.h"
+#include "trace.h"
+#include "timer-handler.h"
+
+/* Maximum number of strict higher priority queues */
+#define MAX_PRIO_QUEUE_NUM 16
+/* Maximum number of QFQ queues in the lowest priority */
+#define MAX_QFQ_QUEUE_NUM 4096
+
+/* Per-queue ECN marking */
+#define PER_QUEUE_MARKING 0
+/* Per-port ECN marking */
+#define PER_PORT_MARKING 1
+/* TCN ECN marking */
+#define TCN_MARKING 2
+
+/* Types of queues */
+#define PRIO_QUEUE 0
+#define QFQ_QUEUE 1
+
+/*
+ * QFQ parameters. Timestamps are fixed point numbers with QFQ_FRAC_BITS
+ * fractional bits. Queues are grouped by the size of their slots
+ * (maximum packet size / weight), which is a power of two.
+ */
+#define QFQ_FRAC_BITS 30
+#define QFQ_ONE_FP (1ULL << QFQ_FRAC_BITS)
+#define QFQ_MAX_INDEX 24	// groups are indexed from 0 to QFQ_MAX_INDEX
+#define QFQ_MAX_SLOTS 32	// buckets per group
+#define QFQ_MAX_WSHIFT 16
+#define QFQ_MAX_WEIGHT (1 << QFQ_MAX_WSHIFT)
+#define QFQ_MTU_SHIFT 11	// packets are no larger than 2KB
+#define QFQ_MIN_SLOT_SHIFT (QFQ_FRAC_BITS + QFQ_MTU_SHIFT - QFQ_MAX_INDEX)
+
+typedef unsigned long long qfq_time_t;
+
+class PacketQfqPRIO;	//strict higher priority queues
+class PacketQFQ;	//QFQ queues in the lowest priority
+class PRIO_QFQ;
+
+class PacketQfqPRIO: public PacketQueue
+{
+	public:
+		PacketQfqPRIO(): thresh(0) {}
+
+		double thresh;	//per-queue ECN marking threshold (pkts)
+		friend class PRIO_QFQ;
+};
+
+class PacketQFQ : public PacketQueue
+{
+	public:
+		PacketQFQ(): weight(1), inv_w(QFQ_ONE_FP), S(0), F(0), grp(0), thresh(0), next(NULL) {}
+
+		int weight;	//weight of the service
+		qfq_time_t inv_w;	//QFQ_ONE_FP / weight
+		qfq_time_t S;	//virtual start time of the head packet
+		qfq_time_t F;	//virtual finish time of the head packet
+		int grp;	//index of the group this queue belongs to
+		double thresh;	//per-queue ECN marking threshold (pkts)
+		PacketQFQ *next;	//next queue in the same bucket
+
+		friend class PRIO_QFQ;
+};
+
+/* A group of QFQ queues with the same slot size */
+class QfqGroup
+{
+	public:
+		QfqGroup(): S(0), F(0), slot_shift(0), front(0), full_slots(0)
+		{
+			for (int i = 0; i < QFQ_MAX_SLOTS; i++)
+				slots[i] = NULL;
+		}
+
+		qfq_time_t S;	//virtual start time of the front bucket
+		qfq_time_t F;	//S + 2 * slot size
+		int slot_shift;	//log2 of the slot size
+		int front;	//index of the front bucket
+		unsigned int full_slots;	//non-empty buckets, relative to front
+		PacketQFQ *slots[QFQ_MAX_SLOTS];	//buckets of queues sorted by rounded start time
+
+		friend class PRIO_QFQ;
+};
+
+class PRIO_QFQ : public Queue
+{
+	public:
+		PRIO_QFQ();
+		~PRIO_QFQ();
+		virtual int command(int argc, const char*const* argv);
+
+	protected:
+		Packet* deque(void);
+		void enque(Packet *pkt);
+		int total_bytelength();	//total length of all the queues in bytes
+		int ecn_mark(int queue_index);	//queue length ECN marking
+		void tcn_mark(Packet *pkt);	//our solution: TCN
+		void init_queues();	//allocate QFQ queues
+		void set_weight(PacketQFQ *q, int weight);	//update weight and group
+		void activate(PacketQFQ *q);	//a QFQ queue becomes backlogged
+		void group_insert(PacketQFQ *q);	//insert a timestamped queue into its group
+		void group_update(QfqGroup *grp);	//after a bucket of the group becomes empty
+		void slot_insert(QfqGroup *grp, PacketQFQ *q);	//insert a queue into its bucket
+		void slot_remove(QfqGroup *grp, PacketQFQ *q);	//remove a queue from its bucket
+		QfqGroup* select_group();	//the eligible group with the earliest finish time
+
+		/* Variables */
+		PacketQfqPRIO *prio_queues;	//strict higher priority queues
+		PacketQFQ *qfq_queues;	//QFQ queues in the lowest priority
+		QfqGroup *groups;	//QFQ groups
+		unsigned int active_groups;	//bitmap of groups with backlogged queues
+
+		qfq_time_t V;	//system virtual time
+		int wsum;	//sum of weights of all the QFQ queues
+		int prio_bytes;	//total length of higher priority queues in bytes
+		int qfq_bytes;	//total length of QFQ queues in bytes
+		int qfq_queue_alloc;	//number of allocated QFQ queues
+		int slot_clamped;	//a queue was put in the last bucket of a group, out of order
+
+		int prio_queue_num_;	//number of higher priority queues
+		int qfq_queue_num_;	//number of QFQ queues
+		int mean_pktsize_;	//MTU in bytes
+		double port_thresh_;	//per-port ECN marking threshold (pkts)
+		int marking_scheme_;	//ECN marking policy
+		double link_capacity_;	//Link capacity
+		int debug_;	//debug more(true) or not(false)
+
+		Tcl_Channel total_qlen_tchan_;	//Place to write total_qlen records
+		Tcl_Channel qlen_tchan_;	//Place to write per-queue qlen records
+		void trace_total_qlen();	//Routine to write total qlen records
+		void trace_qlen();	//Routine to write per-queue qlen records
+};
+
+#endif
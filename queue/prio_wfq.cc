@@ -4,6 +4,7 @@
 #include <float.h>
 #include <math.h>
 #include "flags.h"
+#include "tcp.h"
 #include "prio_wfq.h"
 
 #define max(arg1,arg2) (arg1>arg2 ? arg1 : arg2)
@@ -32,6 +33,9 @@ PRIO_WFQ::PRIO_WFQ()
 	marking_scheme_ = PER_QUEUE_MARKING;
 	link_capacity_ = 10000000000;  //10Gbps
 	debug_ = 0;
+	burst_enable_ = 0;
+	int_enable_ = 0;
+	int_tx_bytes_ = 0;
 
 	total_qlen_tchan_ = NULL;
 	qlen_tchan_ = NULL;
@@ -44,6 +48,14 @@ PRIO_WFQ::PRIO_WFQ()
 	bind("marking_scheme_", &marking_scheme_);
 	bind_bw("link_capacity_", &link_capacity_);
 	bind_bool("debug_", &debug_);
+	bind("pushout_policy_", &pushout_policy_);
+	bind("pushouts_", &pushouts_);
+	bind_bool("burst_enable_", &burst_enable_);
+	bind_time("burst_window_", &burst.window_);
+	bind("burst_thresh_bytes_", &burst.thresh_bytes_);
+	bind_bw("burst_rate_thresh_", &burst.rate_thresh_);
+	bind("bursts_", &burst.bursts_);
+	bind_bool("int_enable_", &int_enable_);
 }
 
 PRIO_WFQ::~PRIO_WFQ()
@@ -125,8 +137,10 @@ int PRIO_WFQ::ecn_mark(int queue_index)
  *  entry points from OTcL to set per queue state variables
  *  - $q set-weight queue_id queue_weight
  *  - $q set-thresh queue_id queue_thresh
+ *  - $q set-protect queue_id queue_protect (pkts protected from pushout)
  *  - $q attach-total file
  *  - $q attach-queue file
+ *  - $q dump-bursts file
  *
  *  NOTE: $q represents the discipline queue variable in OTcl.
  */
@@ -153,6 +167,15 @@ int PRIO_WFQ::command(int argc, const char*const* argv)
 				return (TCL_ERROR);
 			}
 			return (TCL_OK);
+
+		} else if (strcmp(argv[1], "dump-bursts") == 0) {	//microburst records
+			Tcl_Channel chan = Tcl_GetChannel(tcl.interp(), (char*)id, &mode);
+			if (chan == 0) {
+				tcl.resultf("Cannot attach %s for writing", id);
+				return (TCL_ERROR);
+			}
+			burst.dump(chan);
+			return (TCL_OK);
 		}
 
 	} else if (argc == 4) {
@@ -182,11 +205,61 @@ int PRIO_WFQ::command(int argc, const char*const* argv)
                                 fprintf(stderr, "Invalid set-thresh params: %s %s\n", argv[2], argv[3]);
 				exit(1);
 			}
+
+		} else if (strcmp(argv[1], "set-protect") == 0) {      //for all the queues
+			int index = atoi(argv[2]);
+			double protect = atof(argv[3]);
+			if (index < prio_queue_num_ + wfq_queue_num_ && index >= 0 && protect >= 0) {
+				if (index < prio_queue_num_)
+					prio_queues[index].protect = protect;
+				else
+					wfq_queues[index - prio_queue_num_].protect = protect;
+				return (TCL_OK);
+
+			} else {
+				fprintf(stderr, "Invalid set-protect params: %s %s\n", argv[2], argv[3]);
+				exit(1);
+			}
 		}
 	}
 	return (Queue::command(argc, argv));
 }
 
+PacketQueue* PRIO_WFQ::get_queue(int queue_index)
+{
+	if (queue_index < prio_queue_num_)
+		return &prio_queues[queue_index];
+	else
+		return &wfq_queues[queue_index - prio_queue_num_];
+}
+
+/* Packets below this length (bytes) of queue 'index' are never pushed out */
+int PRIO_WFQ::pushout_protect(int index)
+{
+	if (index < prio_queue_num_)
+		return (int)(prio_queues[index].protect * mean_pktsize_);
+	else
+		return (int)(wfq_queues[index - prio_queue_num_].protect * mean_pktsize_);
+}
+
+/*
+ * Evict the tail packet of a queue. The head packet and its finish time
+ * stay the same unless the queue becomes empty.
+ */
+void PRIO_WFQ::pushout_tail(int index)
+{
+	PacketQueue *q = get_queue(index);
+	Packet *pkt = q->tail();
+
+	q->remove(pkt);
+	pushouts_++;
+
+	if (index >= prio_queue_num_ && q->length() == 0)
+		wfq_queues[index - prio_queue_num_].headFinishTime = LDBL_MAX;
+
+	drop(pkt);
+}
+
 /* Receive a new packet */
 void PRIO_WFQ::enque(Packet *p)
 {
@@ -200,16 +273,17 @@ void PRIO_WFQ::enque(Packet *p)
 	prio_queue_num_ = max(min(prio_queue_num_, MAX_PRIO_QUEUE_NUM), 1);
 	int queue_num_ = wfq_queue_num_ + prio_queue_num_;
 
-	/* the shared buffer is overfilld */
-	if (total_bytelength() + pktSize > qlimBytes) {
+	if (prio >= queue_num_ || prio < 0)
+	       prio = queue_num_ - 1;
+
+	/* the shared buffer is overfilld and we cannot push out other packets */
+	if (total_bytelength() + pktSize > qlimBytes &&
+	    !pushout(prio, pktSize, total_bytelength() + pktSize - qlimBytes)) {
 		drop(p);
 		//printf("Packet drop\n");
 		return;
 	}
 
-	if (prio >= queue_num_ || prio < 0)
-	       prio = queue_num_ - 1;
-
         if (prio < prio_queue_num_) {   //strict higher priority queues
                 prio_queues[prio].enque(p);
         } else {        //WFQ queues in the lowest priority
@@ -231,6 +305,9 @@ void PRIO_WFQ::enque(Packet *p)
         /* For TCN ,record enqueue timestamp here */
         else if (marking_scheme_ == TCN_MARKING && hf->ect())
                 hc->timestamp() = Scheduler::instance().clock();
+
+	if (burst_enable_)
+		burst.enque(p, prio, total_bytelength());
 }
 
 void PRIO_WFQ::tcn_mark(Packet *pkt)
@@ -255,6 +332,25 @@ void PRIO_WFQ::tcn_mark(Packet *pkt)
         hc->timestamp() = 0;
 }
 
+/*
+ * INT: count the bytes the port sends, and append a record of this hop
+ * to packets that ask for one. The queue length excludes the packet.
+ */
+void PRIO_WFQ::int_stamp(Packet *pkt)
+{
+	hdr_tcp *tcph = hdr_tcp::access(pkt);
+
+	int_tx_bytes_ += hdr_cmn::access(pkt)->size();
+	if (!tcph->int_on() || tcph->int_nhop() >= MAX_INT_HOPS)
+		return;
+
+	IntHop& hop = tcph->int_hop(tcph->int_nhop()++);
+	hop.ts = Scheduler::instance().clock();
+	hop.txbytes = int_tx_bytes_;
+	hop.rate = link_capacity_;
+	hop.qlen = total_bytelength();
+}
+
 Packet* PRIO_WFQ::deque(void)
 {
 	Packet *pkt = NULL, *nextPkt = NULL;
@@ -267,6 +363,8 @@ Packet* PRIO_WFQ::deque(void)
 				pkt = prio_queues[i].deque();
                                 if (marking_scheme_ == TCN_MARKING)
                                         tcn_mark(pkt);
+				if (int_enable_)
+					int_stamp(pkt);
                                 break;
 			}
 		}
@@ -287,6 +385,8 @@ Packet* PRIO_WFQ::deque(void)
 		pkt = wfq_queues[queue].deque();
                 if (marking_scheme_ == TCN_MARKING)
                         tcn_mark(pkt);
+		if (int_enable_)
+			int_stamp(pkt);
 
 		/* Set the headFinishTime for the remaining head packet in the queue */
 		nextPkt = wfq_queues[queue].head();
@@ -303,6 +403,9 @@ Packet* PRIO_WFQ::deque(void)
         trace_total_qlen();
         trace_qlen();
 
+	if (burst_enable_ && pkt)
+		burst.deque(total_bytelength());
+
 	return pkt;
 }
 
@@ -5,13 +5,15 @@
 #include "config.h"
 #include "trace.h"
 #include "timer-handler.h"
+#include "burst_detector.h"
+#include "pushout.h"
 
 #include <iostream>
 #include <queue>
 using namespace std;
 
 /* Maximum number of strict higher priority queues */
-#define MAX_PRIO_QUEUE_NUM 8
+#define MAX_PRIO_QUEUE_NUM 16
 /* Maximum number of WFQ queues in the lowest priority */
 #define MAX_WFQ_QUEUE_NUM 64
 
@@ -33,25 +35,27 @@ class PRIO_WFQ;
 class PacketPRIO: public PacketQueue
 {
 	public:
-		PacketPRIO(): thresh(0) {}
+		PacketPRIO(): thresh(0), protect(0) {}
 
 		double thresh;	//per-queue ECN marking threshold (pkts)
+		double protect;	//never push out packets below this length (pkts)
 		friend class PRIO_WFQ;
 };
 
 class PacketWFQ : public PacketQueue
 {
 	public:
-		PacketWFQ(): weight(10000.0), headFinishTime(0), thresh(0) {}
+		PacketWFQ(): weight(10000.0), headFinishTime(0), thresh(0), protect(0) {}
 
 		double weight;    //weight of the service
   		long double headFinishTime; //finish time of the packet at head of this queue.
 		double thresh;    //per-queue ECN marking threshold (pkts)
+		double protect;   //never push out packets below this length (pkts)
 
 		friend class PRIO_WFQ;
 };
 
-class PRIO_WFQ : public Queue
+class PRIO_WFQ : public PushoutQueue
 {
 	public:
 		PRIO_WFQ();
@@ -66,6 +70,11 @@ class PRIO_WFQ : public Queue
 		int prio_bytelength();	//total length of higher priority queues in bytes
 		int ecn_mark(int queue_index);	//queue length ECN marking
 		void tcn_mark(Packet *pkt);	//our solution: TCN
+		PacketQueue* get_queue(int queue_index);	//map a queue index to its queue
+		int pushout_queue_num() { return (prio_queue_num_ + wfq_queue_num_); }
+		int pushout_prio_num() { return (prio_queue_num_); }
+		int pushout_protect(int index);	//protected length of a queue in bytes
+		void pushout_tail(int index);	//evict the tail packet of a queue
 
 		/* Variables */
         	PacketPRIO *prio_queues;	//strict higher priority queues
@@ -79,6 +88,11 @@ class PRIO_WFQ : public Queue
         	int marking_scheme_;  //ECN marking policy
         	double link_capacity_;    //Link capacity
         	int debug_;   //debug more(true) or not(false)
+		int burst_enable_;	//detect microbursts (true) or not (false)
+		BurstDetector burst;
+		int int_enable_;	//stamp INT records on departing packets (true) or not (false)
+		double int_tx_bytes_;	//bytes sent by this port
+		void int_stamp(Packet *pkt);	//count and stamp a departing packet
 
         	Tcl_Channel total_qlen_tchan_;  //Place to write total_qlen records
         	Tcl_Channel qlen_tchan_;    //Place to write per-queue qlen records
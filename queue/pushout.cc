@@ -0,0 +1,102 @@
+#include "pushout.h"
+
+PushoutQueue::PushoutQueue() : pushout_policy_(PUSHOUT_NONE), pushouts_(0)
+{
+}
+
+/*
+ * Return the length (bytes) that queue 'index' can be pushed out to
+ * in order to admit a packet to queue 'queue_index', or -1 if this queue
+ * is not a pushout candidate.
+ */
+int PushoutQueue::pushout_floor(int index, int queue_index, int pktSize)
+{
+	int prio_num = pushout_prio_num();
+
+	if (pushout_policy_ == PUSHOUT_LOWEST_PRIO) {
+		/* All the queues after the strict priority ones share the lowest priority */
+		if (min(index, prio_num) <= min(queue_index, prio_num))
+			return -1;
+		return pushout_protect(index);
+	} else if (pushout_policy_ == PUSHOUT_LONGEST) {
+		/* Only push out queues longer than the one we admit to */
+		if (index == queue_index)
+			return -1;
+		return max(pushout_protect(index),
+			   get_queue(queue_index)->byteLength() + pktSize);
+	} else {
+		return -1;
+	}
+}
+
+/* Bytes of the packets of q that lie entirely above 'floor', all at its tail */
+int PushoutQueue::pushout_room(PacketQueue *q, int floor)
+{
+	int offset = 0;
+
+	for (Packet *p = q->head(); p; p = p->next_) {
+		if (offset >= floor)
+			return (q->byteLength() - offset);
+		offset += hdr_cmn::access(p)->size();
+	}
+	return 0;
+}
+
+/*
+ * Pushout: evict packets from the tail of victim queues to free 'bytes'
+ * for a packet to queue 'queue_index'. A victim must keep its floor, so
+ * only a tail packet that lies entirely above the floor may go. Nothing is
+ * evicted unless enough room can be made. Return 1 if the packet can be
+ * admitted.
+ */
+int PushoutQueue::pushout(int queue_index, int pktSize, int bytes)
+{
+	int queue_num = pushout_queue_num();
+	int prio_num = pushout_prio_num();
+	int room = 0;
+	int floor = 0;
+
+	if (pushout_policy_ == PUSHOUT_NONE)
+		return 0;
+
+	for (int i = 0; i < queue_num; i++) {
+		floor = pushout_floor(i, queue_index, pktSize);
+		if (floor >= 0)
+			room += pushout_room(get_queue(i), floor);
+	}
+	if (room < bytes)
+		return 0;
+
+	while (bytes > 0) {
+		int victim = -1;
+		int victim_len = 0;
+
+		for (int i = 0; i < queue_num; i++) {
+			PacketQueue *q = get_queue(i);
+			int len = q->byteLength();
+			floor = pushout_floor(i, queue_index, pktSize);
+			if (floor < 0 || q->length() == 0 ||
+			    len - hdr_cmn::access(q->tail())->size() < floor)
+				continue;
+			if (victim >= 0 && pushout_policy_ == PUSHOUT_LOWEST_PRIO) {
+				int rank = min(i, prio_num);
+				int victim_rank = min(victim, prio_num);
+				/* the lowest priority first, then the longest queue */
+				if (rank < victim_rank || (rank == victim_rank && len <= victim_len))
+					continue;
+			} else if (victim >= 0 && len <= victim_len) {
+				continue;
+			}
+			victim = i;
+			victim_len = len;
+		}
+
+		if (victim < 0)	//This should not happen!
+			return 0;
+
+		bytes -= hdr_cmn::access(get_queue(victim)->tail())->size();
+		pushout_tail(victim);
+	}
+
+	return 1;
+}
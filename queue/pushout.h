@@ -0,0 +1,39 @@
+#ifndef ns_pushout_h
+#define ns_pushout_h
+
+#include "queue.h"
+#include "config.h"
+
+/* Buffer management when the shared buffer is full */
+#define PUSHOUT_NONE 0	// tail drop
+#define PUSHOUT_LOWEST_PRIO 1	// evict from the lowest priority queue
+#define PUSHOUT_LONGEST 2	// evict from the longest queue
+
+/*
+ * Pushout buffer management shared by switch schedulers with strict
+ * priority queues and a group of queues sharing the lowest priority.
+ * Queue indices are those of the scheduler: the strict priority queues
+ * first. A queue never loses a packet that lies, even in part, below its
+ * protected length.
+ */
+class PushoutQueue : public Queue
+{
+	public:
+		PushoutQueue();
+
+	protected:
+		int pushout(int queue_index, int pktSize, int bytes);	//make room for a packet
+		int pushout_floor(int index, int queue_index, int pktSize);	//length limit of pushout
+		int pushout_room(PacketQueue *q, int floor);	//bytes of tail packets above floor
+
+		virtual int pushout_queue_num() = 0;	//number of queues
+		virtual int pushout_prio_num() = 0;	//number of strict priority queues
+		virtual PacketQueue* get_queue(int queue_index) = 0;	//map a queue index to its queue
+		virtual int pushout_protect(int index) = 0;	//protected length of a queue in bytes
+		virtual void pushout_tail(int index) = 0;	//evict the tail packet of a queue
+
+		int pushout_policy_;	//buffer management policy when the buffer is full
+		int pushouts_;	//number of packets pushed out
+};
+
+#endif
@@ -0,0 +1,25 @@
+#Compare DCTCP alpha and ACK counts without and with GRO
+#Runs gro_dctcp_bench.tcl for each setting and prints the change from no GRO
+import os
+import sys
+
+ns_path = '../ns-allinone-2.34/ns-2.34/ns'
+sim_script = 'gro_dctcp_bench.tcl'
+sim_time = 0.2
+
+def run(gro_interval, gro_segs):
+	out = os.popen('%s %s %s %d %s' % (ns_path, sim_script, gro_interval, gro_segs, sim_time)).read()
+	for line in out.splitlines():
+		if line.startswith('gro_interval'):
+			words = line.split()
+			return float(words[5]), int(words[7])
+	print 'no result from: ' + sim_script
+	sys.exit(1)
+
+base_alpha, base_acks = run(0, 1)
+print 'no GRO: alpha %f acks %d' % (base_alpha, base_acks)
+for (gro_interval, gro_segs) in [(5, 4), (20, 8), (20, 16)]:
+	alpha, acks = run(gro_interval, gro_segs)
+	err = abs(alpha - base_alpha) / max(base_alpha, 1e-6)
+	print 'GRO %dus %d segs: alpha %f (error %.3f) acks %d (%.3f)' % \
+		(gro_interval, gro_segs, alpha, err, acks, float(acks) / base_acks)
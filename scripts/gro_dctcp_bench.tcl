@@ -0,0 +1,102 @@
+#GRO benchmark: 4 long DCTCP flows share a 10G bottleneck
+#Usage: ns gro_dctcp_bench.tcl gro_interval(us) gro_segs sim_time
+#Prints the mean DCTCP alpha of the senders and the ACKs of the receivers
+
+source "tcp-common-opt-raw.tcl"
+
+if {$argc != 3} {
+    puts "usage: ns gro_dctcp_bench.tcl gro_interval(us) gro_segs sim_time"
+    exit 0
+}
+
+set gro_interval [expr [lindex $argv 0] / 1000000.0]
+set gro_segs [lindex $argv 1]
+set sim_time [lindex $argv 2]
+set flow_num 4
+set warmup 0.01
+set sample_interval 0.0001
+
+set ns [new Simulator]
+
+Agent/TCP set ecn_ 1
+Agent/TCP set old_ecn_ 1
+Agent/TCP set ecnhat_ true
+Agent/TCPSink set ecnhat_ true
+Agent/TCP set ecnhat_g_ 0.0625
+Agent/TCP set window_ 1256
+Agent/TCP set packetSize_ 1460
+Agent/TCP set minrto_ 0.005
+Agent/TCP set tcpTick_ 0.000001
+Agent/TCP/FullTcp set segsize_ 1460
+Agent/TCP/FullTcp set nodelay_ true
+Agent/TCP/FullTcp set segsperack_ 1
+Agent/TCP/FullTcp set interval_ 0
+Agent/TCP/FullTcp set enable_pias_ false
+Agent/TCP/FullTcp set pias_prio_num_ 1
+Agent/TCP/FullTcp set pias_debug_ false
+Agent/TCP/FullTcp set pias_thresh_0 0
+Agent/TCP/FullTcp set pias_thresh_1 0
+Agent/TCP/FullTcp set pias_thresh_2 0
+Agent/TCP/FullTcp set pias_thresh_3 0
+Agent/TCP/FullTcp set pias_thresh_4 0
+Agent/TCP/FullTcp set pias_thresh_5 0
+Agent/TCP/FullTcp set pias_thresh_6 0
+Agent/TCP/FullTcp set pkt_pool_size_ 16
+Agent/TCP/FullTcp set gro_interval_ $gro_interval
+Agent/TCP/FullTcp set gro_segs_ $gro_segs
+Agent/TCP/FullTcp set lazy_timers_ true
+
+#DCTCP marking at K = 65 packets
+Queue/RED set bytes_ false
+Queue/RED set queue_in_bytes_ true
+Queue/RED set mean_pktsize_ 1500
+Queue/RED set setbit_ true
+Queue/RED set gentle_ false
+Queue/RED set q_weight_ 1.0
+Queue/RED set mark_p_ 1.0
+Queue/RED set thresh_ 65
+Queue/RED set maxthresh_ 65
+
+set router [$ns node]
+set dst [$ns node]
+$ns simplex-link $router $dst 10Gb 5us RED
+$ns simplex-link $dst $router 10Gb 5us DropTail
+$ns queue-limit $router $dst 500
+
+for {set i 0} {$i < $flow_num} {incr i} {
+    set src($i) [$ns node]
+    $ns duplex-link $src($i) $router 40Gb 5us DropTail
+    set tcps($i) [new Agent/TCP/FullTcp/Sack]
+    set tcpr($i) [new Agent/TCP/FullTcp/Sack]
+    $ns attach-agent $src($i) $tcps($i)
+    $ns attach-agent $dst $tcpr($i)
+    $tcpr($i) listen
+    $ns connect $tcps($i) $tcpr($i)
+    $ns at 0.0 "$tcps($i) advance-bytes 2000000000"
+}
+
+set alpha_sum 0.0
+set alpha_num 0
+
+proc sample {} {
+    global ns tcps flow_num alpha_sum alpha_num sample_interval
+    for {set i 0} {$i < $flow_num} {incr i} {
+        set alpha_sum [expr $alpha_sum + [$tcps($i) set ecnhat_alpha_]]
+        incr alpha_num
+    }
+    $ns at [expr [$ns now] + $sample_interval] "sample"
+}
+
+proc finish {} {
+    global tcpr flow_num alpha_sum alpha_num gro_interval gro_segs
+    set acks 0
+    for {set i 0} {$i < $flow_num} {incr i} {
+        set acks [expr $acks + [$tcpr($i) set nackpack_]]
+    }
+    puts "gro_interval $gro_interval gro_segs $gro_segs alpha [expr $alpha_sum / $alpha_num] acks $acks"
+    exit 0
+}
+
+$ns at $warmup "sample"
+$ns at $sim_time "finish"
+$ns run
@@ -0,0 +1,59 @@
+#Benchmark of the FullTcp send path: one long flow between two nodes
+#Usage: ns pkt_pool_bench.tcl pkt_pool_size sim_time
+#Compare segments per second of wall clock time with pkt_pool_size 0 and 16
+
+source "tcp-common-opt-raw.tcl"
+
+if {$argc != 2} {
+    puts "usage: ns pkt_pool_bench.tcl pkt_pool_size sim_time"
+    exit 0
+}
+
+set pool_size [lindex $argv 0]
+set sim_time [lindex $argv 1]
+
+set ns [new Simulator]
+
+Agent/TCP set window_ 1256
+Agent/TCP set packetSize_ 1460
+Agent/TCP/FullTcp set segsize_ 1460
+Agent/TCP/FullTcp set nodelay_ true
+Agent/TCP/FullTcp set segsperack_ 1
+Agent/TCP/FullTcp set interval_ 0
+Agent/TCP/FullTcp set enable_pias_ false
+Agent/TCP/FullTcp set pias_prio_num_ 1
+Agent/TCP/FullTcp set pias_debug_ false
+Agent/TCP/FullTcp set pias_thresh_0 0
+Agent/TCP/FullTcp set pias_thresh_1 0
+Agent/TCP/FullTcp set pias_thresh_2 0
+Agent/TCP/FullTcp set pias_thresh_3 0
+Agent/TCP/FullTcp set pias_thresh_4 0
+Agent/TCP/FullTcp set pias_thresh_5 0
+Agent/TCP/FullTcp set pias_thresh_6 0
+Agent/TCP/FullTcp set pkt_pool_size_ $pool_size
+Agent/TCP/FullTcp set lazy_timers_ true
+
+set n0 [$ns node]
+set n1 [$ns node]
+$ns duplex-link $n0 $n1 100Gb 1us DropTail
+$ns queue-limit $n0 $n1 10000
+
+set tcps [new Agent/TCP/FullTcp/Sack]
+set tcpr [new Agent/TCP/FullTcp/Sack]
+$ns attach-agent $n0 $tcps
+$ns attach-agent $n1 $tcpr
+$tcpr listen
+$ns connect $tcps $tcpr
+
+proc finish {} {
+    global ns tcps start_clock pool_size
+    set elapsed [expr ([clock clicks -milliseconds] - $start_clock) / 1000.0]
+    set segs [$tcps set ndatapack_]
+    puts "pkt_pool_size $pool_size segments $segs wall ${elapsed}s segments/s [expr $segs / $elapsed]"
+    exit 0
+}
+
+set start_clock [clock clicks -milliseconds]
+$ns at 0.0 "$tcps advance-bytes 2000000000"
+$ns at $sim_time "finish"
+$ns run
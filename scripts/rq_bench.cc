@@ -0,0 +1,137 @@
+/*
+ * Stress benchmark of IntervalReassemblyQueue: a full window of segments is
+ * delivered in random order, as with multipath spraying, and added the way
+ * FullTcpAgent::reass() does. A linked list reassembly queue with the same
+ * semantics is run on the same input for comparison.
+ *
+ * g++ -O2 -I../tcp rq_bench.cc ../tcp/interval-rq.cc -o rq_bench
+ * ./rq_bench [window_pkts] [rounds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "interval-rq.h"
+
+#define MSS 1460
+
+/* sorted linked list of blocks, insertion walks from the head */
+class ListRQ {
+public:
+	ListRQ(int& nxt) : head_(NULL), rcv_nxt_(nxt) { }
+	~ListRQ() { clear(); }
+	void add(int start, int end) {
+		Seg **pp = &head_;
+		while (*pp && (*pp)->end < start)
+			pp = &(*pp)->next;
+		Seg *s = new Seg;
+		s->start = start;
+		s->end = end;
+		s->next = *pp;
+		*pp = s;
+		/* coalesce with the following blocks */
+		while (s->next && s->next->start <= s->end) {
+			Seg *n = s->next;
+			if (n->start < s->start)
+				s->start = n->start;
+			if (n->end > s->end)
+				s->end = n->end;
+			s->next = n->next;
+			delete n;
+		}
+		if (s->start <= rcv_nxt_ && s->end > rcv_nxt_)
+			rcv_nxt_ = s->end;
+	}
+	void cleartonxt() {
+		while (head_ && head_->end <= rcv_nxt_) {
+			Seg *n = head_;
+			head_ = n->next;
+			delete n;
+		}
+	}
+	void clear() {
+		while (head_) {
+			Seg *n = head_;
+			head_ = n->next;
+			delete n;
+		}
+	}
+protected:
+	struct Seg {
+		int start;
+		int end;
+		Seg *next;
+	};
+	Seg *head_;
+	int& rcv_nxt_;
+};
+
+static double now_us()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+/* random permutation of a window */
+static void shuffle(int *order, int n)
+{
+	for (int i = 0; i < n; i++)
+		order[i] = i;
+	for (int i = n - 1; i > 0; i--) {
+		int j = rand() % (i + 1);
+		int t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int window = (argc > 1) ? atoi(argv[1]) : 1256;
+	int rounds = (argc > 2) ? atoi(argv[2]) : 1000;
+	int *order = new int[window];
+	int nxt_a = 0, nxt_b = 0;
+	IntervalReassemblyQueue rq(nxt_a);
+	ListRQ lq(nxt_b);
+	double t_rq = 0, t_list = 0, t0 = 0;
+	int sacks[2 * 4];
+
+	srand(1);
+	for (int r = 0; r < rounds; r++) {
+		int base = (r % 2) * window * MSS;
+
+		shuffle(order, window);
+		nxt_a = nxt_b = base;
+
+		t0 = now_us();
+		for (int i = 0; i < window; i++) {
+			int start = base + order[i] * MSS;
+			int fillshole = (start == nxt_a);
+			rq.add(start, start + MSS, 0);
+			if (fillshole)
+				rq.cleartonxt();
+			rq.gensack(sacks, 3);
+		}
+		t_rq += now_us() - t0;
+
+		t0 = now_us();
+		for (int i = 0; i < window; i++) {
+			int start = base + order[i] * MSS;
+			lq.add(start, start + MSS);
+			lq.cleartonxt();
+		}
+		t_list += now_us() - t0;
+
+		if (nxt_a != base + window * MSS || nxt_b != nxt_a || !rq.empty() || rq.total() != 0) {
+			fprintf(stderr, "round %d: mismatch rcv_nxt %d %d expected %d, total %d\n",
+				r, nxt_a, nxt_b, base + window * MSS, rq.total());
+			return 1;
+		}
+	}
+
+	printf("window %d rounds %d\n", window, rounds);
+	printf("interval rq: %.1f ns/segment (with gensack)\n", t_rq * 1000 / ((double)window * rounds));
+	printf("list rq:     %.1f ns/segment\n", t_list * 1000 / ((double)window * rounds));
+	delete [] order;
+	return 0;
+}
@@ -48,6 +48,7 @@ set fct_log [lindex $argv 23]
 set pktSize 1460;   #packet size in bytes
 set quantum [expr $pktSize + 40];   #quantum for each per-service queue
 set weight 100000;  #weight for each queue (WFQ)
+set qfq_weight 1;   #weight for each queue (QFQ, 1 to 65536)
 set link_capacity_unit Gb
 
 puts "Simulation input:"
@@ -106,6 +107,9 @@ Agent/TCP/FullTcp set pias_thresh_3 0
 Agent/TCP/FullTcp set pias_thresh_4 0
 Agent/TCP/FullTcp set pias_thresh_5 0
 Agent/TCP/FullTcp set pias_thresh_6 0
+Agent/TCP/FullTcp set pkt_pool_size_ 16
+Agent/TCP/FullTcp set lazy_timers_ true
+Agent/TCP/FullTcp set dcqcn_line_rate_ $link_rate$link_capacity_unit
 
 if {[string compare $sourceAlg "DCTCP-Sack"] == 0} {
     Agent/TCP set ecnhat_ true
@@ -113,10 +117,58 @@ if {[string compare $sourceAlg "DCTCP-Sack"] == 0} {
     Agent/TCP set ecnhat_g_ $DCTCP_g
 }
 
+#DCTCP with AccECN: exact marked byte counts, so alpha holds with ackRatio > 1
+if {[string compare $sourceAlg "DCTCP-AccECN-Sack"] == 0} {
+    Agent/TCP set ecnhat_ true
+    Agent/TCPSink set ecnhat_ true
+    Agent/TCP set ecnhat_g_ $DCTCP_g
+    Agent/TCP set accecn_ true
+}
+
+#HPCC: INT from the switches sets the window, paced over the base RTT
+set int_enable false
+if {[string compare $sourceAlg "HPCC-Sack"] == 0} {
+    Agent/TCP set ecn_ 0
+    Agent/TCP/FullTcp set cc_mode_ 1
+    Agent/TCP/FullTcp set pace_gain_ 1
+    Agent/TCP/FullTcp set pace_burst_ 0
+    set int_enable true
+}
+
+#Swift: fabric and end-host delay from timestamps, hop count from INT
+if {[string compare $sourceAlg "Swift-Sack"] == 0} {
+    Agent/TCP set ecn_ 0
+    Agent/TCP set timestamps_ true
+    Agent/TCP/FullTcp set cc_mode_ 2
+    set int_enable true
+}
+
+#BBR: paced at the measured bandwidth, ECN marks are ignored
+if {[string compare $sourceAlg "BBR-Sack"] == 0} {
+    Agent/TCP set ecn_ 0
+    Agent/TCP/FullTcp set cc_mode_ 3
+}
+
+#DCQCN: rate based, the receiver turns CE marks into CNPs
+if {[string compare $sourceAlg "DCQCN-Sack"] == 0} {
+    Agent/TCP set ecn_ 1
+    Agent/TCP/FullTcp set cc_mode_ 4
+    Agent/TCP/FullTcp set pace_burst_ 0
+}
+
+#Homa: receivers grant the shortest messages over 8 strict priorities
+set prio_queue_num 1
+if {[string compare $sourceAlg "Homa-Sack"] == 0} {
+    Agent/TCP set ecn_ 0
+    Agent/TCP/FullTcp set cc_mode_ 5
+    Agent/TCP/FullTcp set enable_pias_ false
+    set prio_queue_num [Agent/TCP/FullTcp set homa_prio_num_]
+}
+
 ################# Switch Options ######################
 Queue set limit_ $queueSize
 
-Queue/PrioDwrr set prio_queue_num_ 1
+Queue/PrioDwrr set prio_queue_num_ $prio_queue_num
 Queue/PrioDwrr set dwrr_queue_num_ $service_num
 Queue/PrioDwrr set mean_pktsize_ [expr $pktSize + 40]
 Queue/PrioDwrr set port_thresh_ $DCTCP_K
@@ -125,14 +177,24 @@ Queue/PrioDwrr set mqecn_alpha_ 0.75
 Queue/PrioDwrr set mqecn_interval_bytes_ 1500
 Queue/PrioDwrr set link_capacity_ $link_rate$link_capacity_unit
 Queue/PrioDwrr set debug_ false
+Queue/PrioDwrr set int_enable_ $int_enable
 
-Queue/PrioWfq set prio_queue_num_ 1
+Queue/PrioWfq set prio_queue_num_ $prio_queue_num
 Queue/PrioWfq set wfq_queue_num_ $service_num
 Queue/PrioWfq set mean_pktsize_ [expr $pktSize + 40]
 Queue/PrioWfq set port_thresh_ $DCTCP_K
 Queue/PrioWfq set marking_scheme_ $ECN_scheme
 Queue/PrioWfq set link_capacity_ $link_rate$link_capacity_unit
 Queue/PrioWfq set debug_ false
+Queue/PrioWfq set int_enable_ $int_enable
+
+Queue/PrioQfq set prio_queue_num_ $prio_queue_num
+Queue/PrioQfq set qfq_queue_num_ $service_num
+Queue/PrioQfq set mean_pktsize_ [expr $pktSize + 40]
+Queue/PrioQfq set port_thresh_ $DCTCP_K
+Queue/PrioQfq set marking_scheme_ $ECN_scheme
+Queue/PrioQfq set link_capacity_ $link_rate$link_capacity_unit
+Queue/PrioQfq set debug_ false
 
 ############## Multipathing ###########################
 
@@ -153,6 +215,9 @@ puts "Uplink capacity: $UCap Gbps"
 
 for {set i 0} {$i < $S} {incr i} {
         set s($i) [$ns node]
+        if {[string compare $sourceAlg "Homa-Sack"] == 0} {
+                set homa_ctrl($i) [new HomaGrantController]
+        }
 }
 
 for {set i 0} {$i < $topology_tors} {incr i} {
@@ -179,6 +244,9 @@ for {set i 0} {$i < $S} {incr i} {
                 } elseif {[string compare $switchAlg "PrioWfq"] == 0} {
                         $q set-weight [expr $service_i + 1] $weight
                         $q set-thresh [expr $service_i + 1] $DCTCP_K
+                } elseif {[string compare $switchAlg "PrioQfq"] == 0} {
+                        $q set-weight [expr $service_i + 1] $qfq_weight
+                        $q set-thresh [expr $service_i + 1] $DCTCP_K
                 }
         }
 
@@ -193,6 +261,9 @@ for {set i 0} {$i < $S} {incr i} {
                 } elseif {[string compare $switchAlg "PrioWfq"] == 0} {
                         $q set-weight [expr $service_i + 1] $weight
                         $q set-thresh [expr $service_i + 1] $DCTCP_K
+                } elseif {[string compare $switchAlg "PrioQfq"] == 0} {
+                        $q set-weight [expr $service_i + 1] $qfq_weight
+                        $q set-thresh [expr $service_i + 1] $DCTCP_K
                 }
         }
 }
@@ -214,6 +285,9 @@ for {set i 0} {$i < $topology_tors} {incr i} {
                         } elseif {[string compare $switchAlg "PrioWfq"] == 0} {
                                 $q set-weight [expr $service_i + 1] $weight
                                 $q set-thresh [expr $service_i + 1] $DCTCP_K
+                        } elseif {[string compare $switchAlg "PrioQfq"] == 0} {
+                                $q set-weight [expr $service_i + 1] $qfq_weight
+                                $q set-thresh [expr $service_i + 1] $DCTCP_K
                         }
                 }
 
@@ -229,6 +303,9 @@ for {set i 0} {$i < $topology_tors} {incr i} {
                         } elseif {[string compare $switchAlg "PrioWfq"] == 0} {
                                 $q set-weight [expr $service_i + 1] $weight
                                 $q set-thresh [expr $service_i + 1] $DCTCP_K
+                        } elseif {[string compare $switchAlg "PrioQfq"] == 0} {
+                                $q set-weight [expr $service_i + 1] $qfq_weight
+                                $q set-thresh [expr $service_i + 1] $DCTCP_K
                         }
                 }
         }
@@ -258,6 +335,9 @@ for {set j 0} {$j < $S } {incr j} {
                         set service_id [expr {(($j + 1) * $S + ($i + 1)) % $service_num} + 1]
                         $agtagr($i,$j) setup $s($i) $s($j) "$i $j" $connections_per_pair $init_fid  $service_id "TCP_pair"
                         $agtagr($i,$j) attach-logfile $flowlog
+                        if {[string compare $sourceAlg "Homa-Sack"] == 0} {
+                                $agtagr($i,$j) attach-grant-controller $homa_ctrl($j)
+                        }
 
                         #Assign flow size distribution
                         set flow_cdf "CDF_vl2.tcl"
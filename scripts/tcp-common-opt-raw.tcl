@@ -6,6 +6,110 @@
 #
 set next_fid 0
 
+#Class defaults of the TCN extensions, the same as their C++ constructors
+#Scripts only set the knobs they exercise
+Agent/TCP set rto_hires_ false
+Agent/TCP set min_rtt_win_ 10.0
+Agent/TCP set rtt_hist_ false
+Agent/TCP set accecn_ false
+
+Agent/TCP/FullTcp set pkt_pool_size_ 0;    #0: no packet pool
+Agent/TCP/FullTcp set tso_segs_ 1;    #>1 to send super-segments
+Agent/TCP/FullTcp set gro_interval_ 0;    #>0 to coalesce ACKs
+Agent/TCP/FullTcp set gro_segs_ 1
+Agent/TCP/FullTcp set lazy_timers_ false
+Agent/TCP/FullTcp set pace_gain_ 0;    #>0 to pace at gain * cwnd / srtt
+Agent/TCP/FullTcp set pace_burst_ 2
+Agent/TCP/FullTcp set cc_mode_ 0;    #0: default, 1: HPCC, 2: Swift, 3: BBR, 4: DCQCN, 5: Homa
+Agent/TCP/FullTcp set hpcc_eta_ 0.95
+Agent/TCP/FullTcp set hpcc_max_stage_ 5
+Agent/TCP/FullTcp set hpcc_wai_ 80
+Agent/TCP/FullTcp set hpcc_base_rtt_ 0;    #0: use min RTT
+Agent/TCP/FullTcp set swift_ai_ 1.0
+Agent/TCP/FullTcp set swift_beta_ 0.8
+Agent/TCP/FullTcp set swift_max_mdf_ 0.5
+Agent/TCP/FullTcp set swift_base_target_ 0.000015
+Agent/TCP/FullTcp set swift_hop_scale_ 0.000002
+Agent/TCP/FullTcp set swift_fs_range_ 0.00005
+Agent/TCP/FullTcp set swift_fs_min_cwnd_ 0.1
+Agent/TCP/FullTcp set swift_fs_max_cwnd_ 100
+Agent/TCP/FullTcp set swift_host_target_ 0
+Agent/TCP/FullTcp set swift_min_cwnd_ 0.001
+Agent/TCP/FullTcp set swift_hops_ 0;    #used when INT is off
+Agent/TCP/FullTcp set bbr_high_gain_ 2.885
+Agent/TCP/FullTcp set bbr_cwnd_gain_ 2.0
+Agent/TCP/FullTcp set bbr_bw_rounds_ 10
+Agent/TCP/FullTcp set bbr_probe_rtt_time_ 0.2
+Agent/TCP/FullTcp set bbr_min_cwnd_ 4
+Agent/TCP/FullTcp set dcqcn_line_rate_ 10Gb
+Agent/TCP/FullTcp set dcqcn_min_rate_ 10Mb
+Agent/TCP/FullTcp set dcqcn_g_ 0.00390625
+Agent/TCP/FullTcp set dcqcn_alpha_interval_ 0.000055
+Agent/TCP/FullTcp set dcqcn_rate_interval_ 0.0003
+Agent/TCP/FullTcp set dcqcn_byte_thresh_ 10000000
+Agent/TCP/FullTcp set dcqcn_f_ 5
+Agent/TCP/FullTcp set dcqcn_rai_ 40Mb
+Agent/TCP/FullTcp set dcqcn_rhai_ 200Mb
+Agent/TCP/FullTcp set dcqcn_cnp_interval_ 0.00005
+Agent/TCP/FullTcp set homa_rtt_bytes_ 14600
+Agent/TCP/FullTcp set homa_prio_num_ 8
+Agent/TCP/FullTcp/Sack set dsack_ false
+Agent/TCP/FullTcp/Sack set dsack_reorder_ false
+Agent/TCP/FullTcp/Sack set tlp_ false
+Agent/TCP/FullTcp/Sack set rack_ false
+
+#Statistics read at the end of each flow
+Agent/TCP/FullTcp set ntrimrexmit_ 0
+Agent/TCP/FullTcp set ncnp_ 0
+Agent/TCP/FullTcp/Sack set ndsack_ 0
+Agent/TCP/FullTcp/Sack set ntlp_ 0
+Agent/TCP/FullTcp/Sack set nrack_ 0
+
+PiasController set interval_ 0.01
+PiasController set decay_ 0.5
+PiasController set pias_prio_num_ 2
+PiasController set min_samples_ 100
+PiasController set updates_ 0
+
+HomaGrantController set overcommit_ 2
+HomaGrantController set active_ 0
+
+GsoSegmenter set nsuper_ 0
+GsoSegmenter set nsegs_ 0
+
+Queue/PrioDwrr set mlfq_enable_ false
+Queue/PrioDwrr set mlfq_aging_time_ 0
+Queue/PrioDwrr set mlfq_flows_ 0
+Queue/PrioDwrr set mlfq_evictions_ 0
+Queue/PrioDwrr set trim_enable_ false
+Queue/PrioDwrr set trim_headroom_ 1
+Queue/PrioDwrr set trimmed_pkts_ 0
+Queue/PrioDwrr set pushout_policy_ 0;    #0: tail drop, 1: lowest priority, 2: longest queue
+Queue/PrioDwrr set pushouts_ 0
+Queue/PrioDwrr set burst_enable_ false
+Queue/PrioDwrr set burst_window_ 0.0001
+Queue/PrioDwrr set burst_thresh_bytes_ 0
+Queue/PrioDwrr set burst_rate_thresh_ 0
+Queue/PrioDwrr set bursts_ 0
+Queue/PrioDwrr set int_enable_ false
+
+Queue/PrioWfq set pushout_policy_ 0
+Queue/PrioWfq set pushouts_ 0
+Queue/PrioWfq set burst_enable_ false
+Queue/PrioWfq set burst_window_ 0.0001
+Queue/PrioWfq set burst_thresh_bytes_ 0
+Queue/PrioWfq set burst_rate_thresh_ 0
+Queue/PrioWfq set bursts_ 0
+Queue/PrioWfq set int_enable_ false
+
+Queue/PrioQfq set prio_queue_num_ 1
+Queue/PrioQfq set qfq_queue_num_ 7
+Queue/PrioQfq set mean_pktsize_ 1500
+Queue/PrioQfq set port_thresh_ 65
+Queue/PrioQfq set marking_scheme_ 0
+Queue/PrioQfq set link_capacity_ 10Gb
+Queue/PrioQfq set debug_ false
+
 Class TCP_pair
 
 #Variables:
@@ -37,7 +141,7 @@ Class TCP_pair
 #flow_finished {} {
 
 TCP_pair instproc init {args} {
-    $self instvar pair_id group_id id debug_mode rttimes
+    $self instvar pair_id group_id id debug_mode rttimes tlptimes racktimes
     $self instvar tcps tcpr;# Sender TCP,  Receiver TCP
     global myAgent
     eval $self next $args
@@ -53,6 +157,8 @@ TCP_pair instproc init {args} {
     $self set id       0
     $self set debug_mode 1
     $self set rttimes 0
+    $self set tlptimes 0
+    $self set racktimes 0
 }
 
 TCP_pair instproc set_debug_mode { mode } {
@@ -73,11 +179,25 @@ TCP_pair instproc setup {snode dnode} {
 
     $ns attach-agent $snode $tcps;
     $ns attach-agent $dnode $tcpr;
+    $self insert_gso
 
     $tcpr listen
     $ns connect $tcps $tcpr
 }
 
+#With TSO, put a GsoSegmenter between each agent and its node
+TCP_pair instproc insert_gso {} {
+    $self instvar tcps tcpr
+    if {[$tcps set tso_segs_] <= 1} {
+        return
+    }
+    foreach tcp "$tcps $tcpr" {
+        set gso [new GsoSegmenter]
+        $gso target [$tcp target]
+        $tcp target $gso
+    }
+}
+
 TCP_pair instproc create_agent {} {
     $self instvar tcps tcpr;# Sender TCP,  Receiver TCP
     $self set tcps [new Agent/TCP/FullTcp/Sack]  ;# Sender TCP
@@ -111,11 +231,18 @@ TCP_pair instproc setup_wnode {snode dnode link_dly} {
 
     $ns attach-agent $sn $tcps;
     $ns attach-agent $dn $tcpr;
+    $self insert_gso
 
     $tcpr listen
     $ns connect $tcps $tcpr
 }
 
+#Homa: the receiver reports its messages to the grant controller of its host
+TCP_pair instproc attach-grant-controller { ctrl } {
+    $self instvar tcpr
+    $tcpr attach-grant-controller $ctrl
+}
+
 TCP_pair instproc set_fincallback { controller func} {
     $self instvar aggr_ctrl fin_cbfunc
     $self set aggr_ctrl  $controller
@@ -214,7 +341,7 @@ TCP_pair instproc stop {} {
 
 TCP_pair instproc fin_notify {} {
     global ns
-    $self instvar sn dn san dan rttimes
+    $self instvar sn dn san dan rttimes tlptimes racktimes
     $self instvar tcps tcpr
     $self instvar aggr_ctrl fin_cbfunc
     $self instvar pair_id service_id
@@ -228,6 +355,10 @@ TCP_pair instproc fin_notify {} {
     #Shuang
     set old_rttimes $rttimes
     $self set rttimes [$tcps set nrexmit_]
+    set old_tlptimes $tlptimes
+    $self set tlptimes [$tcps set ntlp_]
+    set old_racktimes $racktimes
+    $self set racktimes [$tcps set nrack_]
 
     #
     # Mohammad commenting these
@@ -237,7 +368,8 @@ TCP_pair instproc fin_notify {} {
     #$tcpr reset
 
     if { [info exists aggr_ctrl] } {
-	$aggr_ctrl $fin_cbfunc $pair_id $bytes $dt $bps [expr $rttimes - $old_rttimes] $service_id
+	$aggr_ctrl $fin_cbfunc $pair_id $bytes $dt $bps [expr $rttimes - $old_rttimes] $service_id \
+	    [expr $tlptimes - $old_tlptimes] [expr $racktimes - $old_racktimes]
     }
 }
 
@@ -275,6 +407,10 @@ Agent/TCP/FullTcp instproc done_data {} {
     }
 }
 
+#Called when a message sent by "advance-msg nbytes id" is fully acked
+Agent/TCP/FullTcp instproc done_msg {id bytes} {
+}
+
 Class Agent_Aggr_pair
 #Note:
 #Contoller and placeholder of Agent_pairs
@@ -333,6 +469,14 @@ Agent_Aggr_pair instproc attach-logfile { logf } {
     $self set logfile $logf
 }
 
+Agent_Aggr_pair instproc attach-grant-controller { ctrl } {
+#Public
+    $self instvar nr_pairs apair
+    for {set i 0} {$i < $nr_pairs} {incr i} {
+	$apair($i) attach-grant-controller $ctrl
+    }
+}
+
 Agent_Aggr_pair instproc setup {snode dnode gid nr init_fid sid agent_pair_type} {
 #Public
 #Note:
@@ -661,12 +805,14 @@ Agent_Aggr_pair instproc check_if_behind {} {
 }
 
 
-Agent_Aggr_pair instproc fin_notify { pid bytes fldur bps rttimes sid} {
+Agent_Aggr_pair instproc fin_notify { pid bytes fldur bps rttimes sid {tlptimes 0} {racktimes 0} } {
 #Callback Function
 #pid  : pair_id
 #bytes : nr of bytes of the flow which has just finished
 #fldur: duration of the flow which has just finished
 #bps  : avg bits/sec of the flow which has just finished
+#tlptimes : tail loss probes sent by the flow
+#racktimes : fast retransmits started by RACK
 #Note:
 #If we registor $self as "setcallback" of
 #$apair($id), $apair($i) will callback this
@@ -694,7 +840,7 @@ Agent_Aggr_pair instproc fin_notify { pid bytes fldur bps rttimes sid} {
         set tmp_pkts [expr $bytes / 1460]
 
 		#puts $logfile "$tmp_pkts $fldur $rttimes"
-		puts $logfile "$tmp_pkts $fldur $rttimes $group_id $sid"
+		puts $logfile "$tmp_pkts $fldur $rttimes $group_id $sid $tlptimes $racktimes"
 		flush stdout
     }
     set flow_fin [expr $flow_fin + 1]
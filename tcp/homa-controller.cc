@@ -0,0 +1,57 @@
+#include <algorithm>
+#include "homa-controller.h"
+
+static class HomaGrantControllerClass : public TclClass {
+public:
+	HomaGrantControllerClass() : TclClass("HomaGrantController") {}
+	TclObject* create(int, const char*const*) {
+		return (new HomaGrantController());
+	}
+} class_homa_grant_controller;
+
+HomaGrantController::HomaGrantController() : overcommit_(2), active_(0)
+{
+	bind("overcommit_", &overcommit_);
+	bind("active_", &active_);
+}
+
+void
+HomaGrantController::update(FullTcpAgent *a, int remaining)
+{
+	int i = 0, n = msgs_.size();
+
+	while (i < n && msgs_[i].a != a)
+		i++;
+
+	if (remaining <= 0) {
+		if (i == n)
+			return;
+		msgs_.erase(msgs_.begin() + i);
+	} else if (i == n) {
+		Msg m;
+		m.a = a;
+		m.remaining = remaining;
+		msgs_.push_back(m);
+	} else {
+		msgs_[i].remaining = remaining;
+	}
+	active_ = msgs_.size();
+	grant(a);
+}
+
+/*
+ * Grant the shortest messages. The reporting agent sends its grant with
+ * the ACK of its data; the others send theirs now if it changed.
+ */
+void
+HomaGrantController::grant(FullTcpAgent *from)
+{
+	int k = std::min(std::max(overcommit_, 1), (int)msgs_.size());
+
+	std::partial_sort(msgs_.begin(), msgs_.begin() + k, msgs_.end(), shorter);
+	for (int i = 0; i < k; i++) {
+		FullTcpAgent *a = msgs_[i].a;
+		if (a->homa_grant(i) && a != from)
+			a->homa_send_grant();
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef ns_homa_controller_h
+#define ns_homa_controller_h
+
+#include <vector>
+#include "tcp-full.h"
+
+/*
+ * Per-host grant controller of receiver-driven (Homa) transport. The
+ * receiving agents of a host report the bytes left of their inbound
+ * messages. The overcommit_ messages with the fewest bytes left are
+ * granted, the shortest at the highest scheduled priority; the others
+ * keep their last grant until one of these completes.
+ */
+class HomaGrantController : public TclObject {
+public:
+	HomaGrantController();
+	void update(FullTcpAgent *a, int remaining);	// bytes left of a's message, 0 when done
+protected:
+	struct Msg {
+		FullTcpAgent *a;
+		int remaining;
+	};
+	static bool shorter(const Msg& x, const Msg& y) { return (x.remaining < y.remaining); }
+	void grant(FullTcpAgent *from);
+
+	std::vector<Msg> msgs_;	// active inbound messages
+	int overcommit_;	// messages granted at a time
+	int active_;	// messages with bytes left
+};
+
+#endif
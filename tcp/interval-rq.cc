@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "interval-rq.h"
+
+/*
+ * Binary search for the first block with end > seq, or end >= seq if
+ * inclusive. The loop has no data dependent branch, as holes arrive in
+ * random order.
+ */
+int
+IntervalReassemblyQueue::first_end_after(int seq, int inclusive)
+{
+	int key = inclusive ? seq - 1 : seq;
+	int n = blocks_.size();
+	const Block *b = NULL;
+
+	if (n == 0)
+		return (0);
+
+	b = &blocks_[0];
+	while (n > 1) {
+		int half = n / 2;
+		b = (b[half].end <= key) ? b + half : b;
+		n -= half;
+	}
+	return ((b - &blocks_[0]) + (b->end <= key));
+}
+
+int
+IntervalReassemblyQueue::find(int seq)
+{
+	int i = first_end_after(seq, 1);
+
+	if (i < (int)blocks_.size() && blocks_[i].start <= seq)
+		return (i);
+	return (-1);
+}
+
+int
+IntervalReassemblyQueue::contains(int start, int end)
+{
+	int i = find(start);
+
+	return (i >= 0 && blocks_[i].end >= end);
+}
+
+/*
+ * Add segment [start, end) and coalesce it with the blocks it overlaps
+ * or touches. rcv_nxt_ advances if the segment fills the hole at rcv_nxt_.
+ * Return the flags of the resulting block.
+ */
+int
+IntervalReassemblyQueue::add(int start, int end, int pflags, int rqflags)
+{
+	int lo = 0, hi = 0;
+	int size = blocks_.size();
+	Block b;
+
+	if (end < start) {
+		fprintf(stderr, "IntervalReassemblyQueue::add() - end(%d) before start(%d)\n", end, start);
+		abort();
+	}
+
+	recent_head_ = (recent_head_ + IRQ_RECENT_NUM - 1) % IRQ_RECENT_NUM;
+	recent_[recent_head_] = start;
+	if (recent_num_ < IRQ_RECENT_NUM)
+		recent_num_++;
+
+	/* blocks [lo, hi) overlap or touch the segment */
+	lo = first_end_after(start, 1);
+	hi = lo;
+	while (hi < size && blocks_[hi].start <= end)
+		hi++;
+
+	/* all the data is already here */
+	if (hi - lo == 1 && blocks_[lo].start <= start && blocks_[lo].end >= end) {
+		blocks_[lo].pflags |= pflags;
+		return (blocks_[lo].pflags);
+	}
+
+	b.start = start;
+	b.end = end;
+	b.pflags = pflags;
+	b.rqflags = rqflags;
+	b.cnt = 1;
+	for (int i = lo; i < hi; i++) {
+		if (blocks_[i].start < b.start)
+			b.start = blocks_[i].start;
+		if (blocks_[i].end > b.end)
+			b.end = blocks_[i].end;
+		b.pflags |= blocks_[i].pflags;
+		b.rqflags |= blocks_[i].rqflags;
+		b.cnt += blocks_[i].cnt;
+		total_ -= blocks_[i].end - blocks_[i].start;
+	}
+	total_ += b.end - b.start;
+	if (b.start < low_change_)
+		low_change_ = b.start;
+
+	if (lo == hi) {
+		blocks_.insert(blocks_.begin() + lo, b);
+	} else {
+		blocks_[lo] = b;
+		blocks_.erase(blocks_.begin() + lo + 1, blocks_.begin() + hi);
+	}
+
+	if (b.start <= rcv_nxt_ && b.end > rcv_nxt_)
+		rcv_nxt_ = b.end;
+
+	return (b.pflags);
+}
+
+int
+IntervalReassemblyQueue::clearto(int seq)
+{
+	int flags = 0;
+	int n = 0;
+	int size = blocks_.size();
+
+	while (n < size && blocks_[n].end <= seq) {
+		flags |= blocks_[n].pflags;
+		total_ -= blocks_[n].end - blocks_[n].start;
+		n++;
+	}
+	if (n > 0)
+		blocks_.erase(blocks_.begin(), blocks_.begin() + n);
+
+	/* we might be trimming in the middle of a block */
+	if (!blocks_.empty() && blocks_[0].start < seq) {
+		total_ -= seq - blocks_[0].start;
+		blocks_[0].start = seq;
+	}
+
+	return (flags);
+}
+
+/*
+ * Return the first seq# >= seq that is missing and followed by a block,
+ * with the segment count and bytes of that block, or -1 if none.
+ */
+int
+IntervalReassemblyQueue::nexthole(int seq, int& nxtcnt, int& nxtbytes)
+{
+	int i = first_end_after(seq, 0);
+	int hole = seq;
+
+	nxtcnt = nxtbytes = -1;
+	if (i == (int)blocks_.size())
+		return (-1);
+
+	/* seq is already in block i */
+	if (blocks_[i].start <= seq) {
+		hole = blocks_[i].end;
+		if (++i == (int)blocks_.size())
+			return (-1);
+	}
+
+	nxtcnt = blocks_[i].cnt;
+	nxtbytes = blocks_[i].end - blocks_[i].start;
+	return (hole);
+}
+
+/*
+ * Fill SACK blocks, the block of the most recently added segment first.
+ * Blocks not found among the recent segments follow in seq# order.
+ */
+int
+IntervalReassemblyQueue::gensack(int *sacks, int maxsblock)
+{
+	int used[IRQ_RECENT_NUM];
+	int nused = 0;
+	int n = 0;
+
+	for (int k = 0; k < recent_num_ && n < maxsblock; k++) {
+		int i = find(recent_[(recent_head_ + k) % IRQ_RECENT_NUM]);
+		int dup = 0;
+
+		if (i < 0)
+			continue;
+		for (int j = 0; j < nused; j++)
+			dup |= (used[j] == i);
+		if (dup)
+			continue;
+
+		used[nused++] = i;
+		sacks[2 * n] = blocks_[i].start;
+		sacks[2 * n + 1] = blocks_[i].end;
+		n++;
+	}
+
+	for (int i = 0; i < (int)blocks_.size() && n < maxsblock; i++) {
+		int dup = 0;
+
+		for (int j = 0; j < nused; j++)
+			dup |= (used[j] == i);
+		if (dup)
+			continue;
+
+		sacks[2 * n] = blocks_[i].start;
+		sacks[2 * n + 1] = blocks_[i].end;
+		n++;
+	}
+
+	return (n);
+}
+
+void
+IntervalReassemblyQueue::clear()
+{
+	blocks_.clear();	// keeps the storage
+	total_ = 0;
+	recent_num_ = 0;
+	low_change_ = INT_MAX;
+}
+
+void
+IntervalReassemblyQueue::init(int nxt)
+{
+	clear();
+	rcv_nxt_ = nxt;
+}
+
+void
+IntervalReassemblyQueue::dumplist()
+{
+	printf("rcv_nxt: %d, total: %d, blocks: %d\n", rcv_nxt_, total_, (int)blocks_.size());
+	for (int i = 0; i < (int)blocks_.size(); i++)
+		printf("\t[%d, %d) flags 0x%x cnt %d\n", blocks_[i].start, blocks_[i].end,
+		       blocks_[i].pflags, blocks_[i].cnt);
+}
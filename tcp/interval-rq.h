@@ -0,0 +1,61 @@
+#ifndef ns_interval_rq_h
+#define ns_interval_rq_h
+
+#include <limits.h>
+#include <vector>
+
+/* recently added segments remembered to order SACK blocks */
+#define IRQ_RECENT_NUM	8
+
+/*
+ * Reassembly queue kept as a sorted array of disjoint blocks of sequence
+ * numbers [start, end). A segment is located by binary search, so adding
+ * and coalescing costs O(log n) comparisons plus a move of the blocks
+ * after it. The interface follows ns's ReassemblyQueue, and the array
+ * keeps its storage across clear() so blocks are not reallocated.
+ */
+class IntervalReassemblyQueue {
+public:
+	IntervalReassemblyQueue(int& nxt) : rcv_nxt_(nxt), total_(0), recent_head_(0), recent_num_(0),
+		low_change_(INT_MAX) { }
+	int empty() { return (blocks_.empty()); }
+	int add(int start, int end, int pflags, int rqflags = 0);
+	int cleartonxt() { return (clearto(rcv_nxt_)); }
+	int clearto(int seq);	// remove data below seq, return flags of removed blocks
+	int total() { return (total_); }	// bytes in the queue
+	int nexthole(int seq, int& nxtcnt, int& nxtbytes);
+	int gensack(int *sacks, int maxsblock);
+	int contains(int start, int end);	// is [start, end) all in one block?
+	void clear();
+	void init(int nxt);
+	void dumplist();
+	int maxseq() { return (blocks_.empty() ? -1 : blocks_.back().end); }
+	int minseq() { return (blocks_.empty() ? -1 : blocks_.front().start); }
+	int lowchange() {	// lowest start of blocks changed since the last call
+		int seq = low_change_;
+		low_change_ = INT_MAX;
+		return (seq);
+	}
+
+protected:
+	struct Block {
+		int start;
+		int end;	// one past the last byte
+		int pflags;	// TCP flags of the segments
+		int rqflags;
+		int cnt;	// number of segments
+	};
+
+	int first_end_after(int seq, int inclusive);	// first block with end > seq (>= if inclusive)
+	int find(int seq);	// block containing seq, -1 if none
+
+	std::vector<Block> blocks_;
+	int& rcv_nxt_;
+	int total_;
+	int recent_[IRQ_RECENT_NUM];	// start of recently added segments
+	int recent_head_;
+	int recent_num_;
+	int low_change_;	// INT_MAX if no block changed
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "template.h"
+#include "pias-controller.h"
+
+static class PiasControllerClass : public TclClass {
+public:
+	PiasControllerClass() : TclClass("PiasController") {}
+	TclObject* create(int, const char*const*) {
+		return (new PiasController());
+	}
+} class_pias_controller;
+
+void PiasControllerTimer::expire(Event *)
+{
+	c_->timeout();
+}
+
+PiasController::PiasController() : interval_(0.01), decay_(0.5), pias_prio_num_(2),
+	min_samples_(100), updates_(0), timer_(this), log_tchan_(0)
+{
+	for (int i = 0; i < MAX_PIAS_SERVICE_NUM; i++) {
+		sketch_[i] = NULL;
+		samples_[i] = 0;
+		prio_num_[i] = 0;
+	}
+
+	bind_time("interval_", &interval_);
+	bind("decay_", &decay_);
+	bind("pias_prio_num_", &pias_prio_num_);
+	bind("min_samples_", &min_samples_);
+	bind("updates_", &updates_);
+}
+
+PiasController::~PiasController()
+{
+	for (int i = 0; i < MAX_PIAS_SERVICE_NUM; i++)
+		delete [] sketch_[i];
+}
+
+/*
+ *  entry points from OTcL
+ *   - $ctrl start (update thresholds every interval_)
+ *   - $ctrl update
+ *   - $ctrl attach-log file
+ *   - $ctrl get-thresh service_id
+ *   - $ctrl record service_id bytes (e.g., seed from a flow size CDF)
+ */
+int PiasController::command(int argc, const char*const* argv)
+{
+	Tcl& tcl = Tcl::instance();
+
+	if (argc == 2) {
+		if (strcmp(argv[1], "start") == 0) {
+			if (interval_ > 0)
+				timer_.resched(interval_);
+			return (TCL_OK);
+		}
+		if (strcmp(argv[1], "update") == 0) {
+			update();
+			return (TCL_OK);
+		}
+	} else if (argc == 3) {
+		if (strcmp(argv[1], "attach-log") == 0) {
+			int mode;
+			log_tchan_ = Tcl_GetChannel(tcl.interp(), (char*)argv[2], &mode);
+			if (log_tchan_ == 0) {
+				tcl.resultf("Cannot attach %s for writing", argv[2]);
+				return (TCL_ERROR);
+			}
+			return (TCL_OK);
+		}
+		if (strcmp(argv[1], "get-thresh") == 0) {
+			int thresh[MAX_PIAS_PRIO_NUM - 1];
+			char wrk[200] = {0};
+			int len = 0;
+			int num = snapshot(atoi(argv[2]), thresh);
+
+			for (int i = 0; i < num - 1; i++)
+				len += sprintf(wrk + len, "%s%d", i ? " " : "", thresh[i]);
+			tcl.result(wrk);
+			return (TCL_OK);
+		}
+	} else if (argc == 4) {
+		if (strcmp(argv[1], "record") == 0) {
+			record(atoi(argv[2]), atoi(argv[3]));
+			return (TCL_OK);
+		}
+	}
+	return (TclObject::command(argc, argv));
+}
+
+int PiasController::bin(int bytes)
+{
+	int e = 0;
+	double m = 0;
+
+	if (bytes < 1)
+		return 0;
+
+	/* bytes = m * 2^e, 0.5 <= m < 1 */
+	m = frexp((double)bytes, &e);
+	return (e - 1) * PIAS_SKETCH_SUB + (int)((2 * m - 1) * PIAS_SKETCH_SUB);
+}
+
+int PiasController::bin_upper(int bin)
+{
+	int e = bin / PIAS_SKETCH_SUB;
+	int sub = bin % PIAS_SKETCH_SUB;
+	double upper = ldexp(1.0 + (double)(sub + 1) / PIAS_SKETCH_SUB, e) - 1;
+
+	return (upper < INT_MAX) ? (int)upper : INT_MAX;
+}
+
+/* O(1) per flow completion */
+void PiasController::record(int service, int bytes)
+{
+	if (service < 0 || service >= MAX_PIAS_SERVICE_NUM || bytes <= 0)
+		return;
+
+	if (!sketch_[service]) {
+		sketch_[service] = new double[PIAS_SKETCH_BINS];
+		for (int i = 0; i < PIAS_SKETCH_BINS; i++)
+			sketch_[service][i] = 0;
+	}
+
+	sketch_[service][bin(bytes)] += 1;
+	samples_[service] += 1;
+}
+
+int PiasController::snapshot(int service, int *thresh)
+{
+	if (service < 0 || service >= MAX_PIAS_SERVICE_NUM || prio_num_[service] == 0)
+		return 0;
+
+	for (int i = 0; i < prio_num_[service] - 1; i++)
+		thresh[i] = thresh_[service][i];
+
+	return prio_num_[service];
+}
+
+/*
+ * Set the thresholds of each service with enough samples to the
+ * i/pias_prio_num_ quantiles of its flow sizes, then decay the sketch.
+ */
+void PiasController::update()
+{
+	int levels = max(min(pias_prio_num_, MAX_PIAS_PRIO_NUM), 1);
+
+	for (int s = 0; s < MAX_PIAS_SERVICE_NUM; s++) {
+		double *sketch = sketch_[s];
+		double cum = 0;
+		int level = 1;
+
+		if (!sketch || samples_[s] <= 0)
+			continue;
+
+		if (samples_[s] >= min_samples_) {
+			for (int b = 0; b < PIAS_SKETCH_BINS && level < levels; b++) {
+				cum += sketch[b];
+				while (level < levels && cum >= samples_[s] * level / levels - 1e-9) {
+					thresh_[s][level - 1] = bin_upper(b);
+					level++;
+				}
+			}
+			for (; level < levels; level++)
+				thresh_[s][level - 1] = INT_MAX;
+
+			prio_num_[s] = levels;
+			log(s);
+		}
+
+		for (int b = 0; b < PIAS_SKETCH_BINS; b++)
+			sketch[b] *= decay_;
+		samples_[s] *= decay_;
+	}
+
+	updates_++;
+}
+
+void PiasController::timeout()
+{
+	update();
+	if (interval_ > 0)
+		timer_.resched(interval_);
+}
+
+/* routine to write threshold records */
+void PiasController::log(int service)
+{
+	if (!log_tchan_)
+		return;
+
+	char wrk[300] = {0};
+	int len = sprintf(wrk, "%g, %d, %g,", Scheduler::instance().clock(), service, samples_[service]);
+
+	for (int i = 0; i < prio_num_[service] - 1; i++)
+		len += sprintf(wrk + len, " %d", thresh_[service][i]);
+	len += sprintf(wrk + len, "\n");
+
+	Tcl_Write(log_tchan_, wrk, len);
+}
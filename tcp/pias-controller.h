@@ -0,0 +1,56 @@
+#ifndef ns_pias_controller_h
+#define ns_pias_controller_h
+
+#include "timer-handler.h"
+#include "tcp-full.h"
+
+/* log-binned flow size sketch: PIAS_SKETCH_SUB bins per power of two */
+#define PIAS_SKETCH_SUB		8
+#define PIAS_SKETCH_BINS	(32 * PIAS_SKETCH_SUB)
+
+class PiasController;
+
+class PiasControllerTimer : public TimerHandler {
+public:
+	PiasControllerTimer(PiasController *c) : TimerHandler(), c_(c) { }
+protected:
+	virtual void expire(Event *);
+	PiasController *c_;
+};
+
+/*
+ * Per-host controller of adaptive PIAS thresholds. Agents report the size
+ * of each completed flow. Every interval_, the thresholds of each service
+ * are set to the quantiles of its flow sizes, so that each priority level
+ * carries an equal share of flows. Old samples decay by decay_.
+ */
+class PiasController : public TclObject {
+public:
+	PiasController();
+	~PiasController();
+	virtual int command(int argc, const char*const* argv);
+	void record(int service, int bytes);	// a flow of the service completes
+	int snapshot(int service, int *thresh);	// copy thresholds, return number of priorities
+	void update();	// recompute thresholds
+	void timeout();	// periodic update
+protected:
+	static int bin(int bytes);	// bin of a flow size
+	static int bin_upper(int bin);	// largest flow size of a bin
+	void log(int service);
+
+	double *sketch_[MAX_PIAS_SERVICE_NUM];	// allocated on the first sample
+	double samples_[MAX_PIAS_SERVICE_NUM];	// decayed number of samples
+	int thresh_[MAX_PIAS_SERVICE_NUM][MAX_PIAS_PRIO_NUM - 1];
+	int prio_num_[MAX_PIAS_SERVICE_NUM];	// 0 before enough samples
+
+	double interval_;	// time between updates
+	double decay_;	// weight of old samples after an update
+	int pias_prio_num_;	// number of priorities
+	int min_samples_;	// samples needed before thresholds are set
+	int updates_;	// number of updates
+
+	PiasControllerTimer timer_;
+	Tcl_Channel log_tchan_;	// place to write threshold records
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "send-time-q.h"
+
+void
+SendTimeQueue::grow()
+{
+	int size = ring_.size();
+	std::vector<Seg> ring(size > 0 ? 2 * size : 64);
+
+	for (int i = 0; i < num_; i++)
+		ring[i] = at(i);
+	ring_.swap(ring);
+	head_ = 0;
+}
+
+int
+SendTimeQueue::find(int seq)
+{
+	int lo = 0, hi = num_;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (at(mid).end <= seq)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo);
+}
+
+/*
+ * Data at or beyond the last segment is appended in MSS pieces. Data
+ * below it is a retransmission, which restamps the segments it covers.
+ */
+void
+SendTimeQueue::sent(int seq, int len, int mss, double now, const TxState *tx)
+{
+	int end = seq + len;
+
+	if (len <= 0 || mss <= 0)
+		return;
+
+	if (num_ == 0 || seq >= at(num_ - 1).end) {
+		for (; seq < end; seq += mss) {
+			if (num_ == (int)ring_.size())
+				grow();
+			Seg& s = at(num_++);
+			s.start = seq;
+			s.end = (seq + mss < end) ? seq + mss : end;
+			s.ts = now;
+			s.rexmit = 0;
+			if (tx)
+				s.tx = *tx;
+		}
+		return;
+	}
+
+	for (int i = find(seq); i < num_ && at(i).start < end; i++) {
+		at(i).ts = now;
+		at(i).rexmit = 1;
+		if (tx)
+			at(i).tx = *tx;
+	}
+}
+
+void
+SendTimeQueue::clearto(int seq)
+{
+	while (num_ > 0 && at(0).end <= seq) {
+		head_ = (head_ + 1) & (ring_.size() - 1);
+		num_--;
+	}
+}
+
+int
+SendTimeQueue::lookup(int seq, double& ts, int& end, int& rexmit, TxState *tx)
+{
+	int i = find(seq);
+
+	if (i == num_ || at(i).start > seq)
+		return (0);
+	ts = at(i).ts;
+	end = at(i).end;
+	rexmit = at(i).rexmit;
+	if (tx)
+		*tx = at(i).tx;
+	return (1);
+}
@@ -0,0 +1,48 @@
+#ifndef ns_send_time_q_h
+#define ns_send_time_q_h
+
+#include <vector>
+
+/* delivery state when a segment was sent, for delivery rate samples */
+struct TxState {
+	int delivered;	// bytes delivered before the send
+	double delivered_ts;	// time delivered last grew
+	double first_ts;	// send time of the first segment of the sample
+	int app_limited;	// sent while the application had no more data?
+};
+
+/*
+ * Send time of each outstanding segment, for RACK loss detection and
+ * delivery rate samples.
+ * Segments are kept in seq# order in a ring that grows by doubling,
+ * one entry per MSS so that a TSO super-segment can be retransmitted
+ * in pieces. A segment is located by binary search.
+ */
+class SendTimeQueue {
+public:
+	SendTimeQueue() : head_(0), num_(0) { }
+	int empty() { return (num_ == 0); }
+	void sent(int seq, int len, int mss, double now, const TxState *tx = 0);	// new data or a retransmission
+	void clearto(int seq);	// drop segments that end at or below seq
+	int lookup(int seq, double& ts, int& end, int& rexmit, TxState *tx = 0);	// segment containing seq?
+	void clear() { head_ = num_ = 0; }	// keeps the storage
+
+protected:
+	struct Seg {
+		int start;
+		int end;	// one past the last byte
+		double ts;	// time of the last transmission
+		int rexmit;	// retransmitted?
+		TxState tx;	// unset unless sent() was given one
+	};
+
+	Seg& at(int i) { return (ring_[(head_ + i) & (ring_.size() - 1)]); }
+	int find(int seq);	// first segment with end > seq
+	void grow();
+
+	std::vector<Seg> ring_;	// size is a power of two
+	int head_;
+	int num_;
+};
+
+#endif
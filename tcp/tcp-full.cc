@@ -41,12 +41,15 @@ static const char rcsid[] =
     "@(#) $Header: /cvsroot/nsnam/ns-2/tcp/tcp-full.cc,v 1.128 2009/03/29 20:59:41 sallyfloyd Exp $ (LBL)";
 #endif
 
+#include <limits.h>
 #include "ip.h"
 #include "tcp-full.h"
 #include "flags.h"
 #include "random.h"
 #include "template.h"
 #include "math.h"
+#include "pias-controller.h"
+#include "homa-controller.h"
 
 #ifndef TRUE
 #define	TRUE 	1
@@ -171,6 +174,46 @@ FullTcpAgent::delay_bind_init_all()
     delay_bind_init_one("pias_thresh_5"); //wei
     delay_bind_init_one("pias_thresh_6"); //wei
     delay_bind_init_one("pias_debug_"); //wei
+	delay_bind_init_one("pkt_pool_size_");
+	delay_bind_init_one("tso_segs_");
+	delay_bind_init_one("gro_interval_");
+	delay_bind_init_one("gro_segs_");
+	delay_bind_init_one("lazy_timers_");
+	delay_bind_init_one("pace_gain_");
+	delay_bind_init_one("pace_burst_");
+	delay_bind_init_one("cc_mode_");
+	delay_bind_init_one("hpcc_eta_");
+	delay_bind_init_one("hpcc_max_stage_");
+	delay_bind_init_one("hpcc_wai_");
+	delay_bind_init_one("hpcc_base_rtt_");
+	delay_bind_init_one("swift_ai_");
+	delay_bind_init_one("swift_beta_");
+	delay_bind_init_one("swift_max_mdf_");
+	delay_bind_init_one("swift_base_target_");
+	delay_bind_init_one("swift_hop_scale_");
+	delay_bind_init_one("swift_fs_range_");
+	delay_bind_init_one("swift_fs_min_cwnd_");
+	delay_bind_init_one("swift_fs_max_cwnd_");
+	delay_bind_init_one("swift_host_target_");
+	delay_bind_init_one("swift_min_cwnd_");
+	delay_bind_init_one("swift_hops_");
+	delay_bind_init_one("bbr_high_gain_");
+	delay_bind_init_one("bbr_cwnd_gain_");
+	delay_bind_init_one("bbr_bw_rounds_");
+	delay_bind_init_one("bbr_probe_rtt_time_");
+	delay_bind_init_one("bbr_min_cwnd_");
+	delay_bind_init_one("dcqcn_line_rate_");
+	delay_bind_init_one("dcqcn_min_rate_");
+	delay_bind_init_one("dcqcn_g_");
+	delay_bind_init_one("dcqcn_alpha_interval_");
+	delay_bind_init_one("dcqcn_rate_interval_");
+	delay_bind_init_one("dcqcn_byte_thresh_");
+	delay_bind_init_one("dcqcn_f_");
+	delay_bind_init_one("dcqcn_rai_");
+	delay_bind_init_one("dcqcn_rhai_");
+	delay_bind_init_one("dcqcn_cnp_interval_");
+	delay_bind_init_one("homa_rtt_bytes_");
+	delay_bind_init_one("homa_prio_num_");
 
 	TcpAgent::delay_bind_init_all();
 
@@ -228,6 +271,48 @@ FullTcpAgent::delay_bind_dispatch(const char *varName, const char *localName, Tc
     if (delay_bind_bool(varName, localName, "pias_debug_", &pias_debug_, tracer)) return TCL_OK;
     if (delay_bind(varName, localName, "serviceid_", &serviceid_, tracer)) return TCL_OK;
     if (delay_bind(varName, localName, "bytes_", &bytes_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "ntrimrexmit_", &ntrimrexmit_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "pkt_pool_size_", &pkt_pool_size_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "tso_segs_", &tso_segs_, tracer)) return TCL_OK;
+	if (delay_bind_time(varName, localName, "gro_interval_", &gro_interval_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "gro_segs_", &gro_segs_, tracer)) return TCL_OK;
+	if (delay_bind_bool(varName, localName, "lazy_timers_", &lazy_timers_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "pace_gain_", &pace_gain_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "pace_burst_", &pace_burst_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "cc_mode_", &cc_mode_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "hpcc_eta_", &hpcc_eta_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "hpcc_max_stage_", &hpcc_max_stage_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "hpcc_wai_", &hpcc_wai_, tracer)) return TCL_OK;
+	if (delay_bind_time(varName, localName, "hpcc_base_rtt_", &hpcc_base_rtt_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "swift_ai_", &swift_ai_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "swift_beta_", &swift_beta_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "swift_max_mdf_", &swift_max_mdf_, tracer)) return TCL_OK;
+	if (delay_bind_time(varName, localName, "swift_base_target_", &swift_base_target_, tracer)) return TCL_OK;
+	if (delay_bind_time(varName, localName, "swift_hop_scale_", &swift_hop_scale_, tracer)) return TCL_OK;
+	if (delay_bind_time(varName, localName, "swift_fs_range_", &swift_fs_range_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "swift_fs_min_cwnd_", &swift_fs_min_cwnd_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "swift_fs_max_cwnd_", &swift_fs_max_cwnd_, tracer)) return TCL_OK;
+	if (delay_bind_time(varName, localName, "swift_host_target_", &swift_host_target_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "swift_min_cwnd_", &swift_min_cwnd_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "swift_hops_", &swift_hops_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "bbr_high_gain_", &bbr_high_gain_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "bbr_cwnd_gain_", &bbr_cwnd_gain_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "bbr_bw_rounds_", &bbr_bw_rounds_, tracer)) return TCL_OK;
+	if (delay_bind_time(varName, localName, "bbr_probe_rtt_time_", &bbr_probe_rtt_time_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "bbr_min_cwnd_", &bbr_min_cwnd_, tracer)) return TCL_OK;
+	if (delay_bind_bw(varName, localName, "dcqcn_line_rate_", &dcqcn_line_rate_, tracer)) return TCL_OK;
+	if (delay_bind_bw(varName, localName, "dcqcn_min_rate_", &dcqcn_min_rate_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "dcqcn_g_", &dcqcn_g_, tracer)) return TCL_OK;
+	if (delay_bind_time(varName, localName, "dcqcn_alpha_interval_", &dcqcn_alpha_interval_, tracer)) return TCL_OK;
+	if (delay_bind_time(varName, localName, "dcqcn_rate_interval_", &dcqcn_rate_interval_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "dcqcn_byte_thresh_", &dcqcn_byte_thresh_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "dcqcn_f_", &dcqcn_f_, tracer)) return TCL_OK;
+	if (delay_bind_bw(varName, localName, "dcqcn_rai_", &dcqcn_rai_, tracer)) return TCL_OK;
+	if (delay_bind_bw(varName, localName, "dcqcn_rhai_", &dcqcn_rhai_, tracer)) return TCL_OK;
+	if (delay_bind_time(varName, localName, "dcqcn_cnp_interval_", &dcqcn_cnp_interval_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "ncnp_", &ncnp_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "homa_rtt_bytes_", &homa_rtt_bytes_, tracer)) return TCL_OK;
+	if (delay_bind(varName, localName, "homa_prio_num_", &homa_prio_num_, tracer)) return TCL_OK;
 
     return TcpAgent::delay_bind_dispatch(varName, localName, tracer);
 }
@@ -242,6 +327,10 @@ SackFullTcpAgent::delay_bind_init_all()
         delay_bind_init_one("sack_option_size_");
         delay_bind_init_one("max_sack_blocks_");
         delay_bind_init_one("sack_rtx_threshmode_");
+        delay_bind_init_one("dsack_");
+        delay_bind_init_one("dsack_reorder_");
+        delay_bind_init_one("tlp_");
+        delay_bind_init_one("rack_");
 	FullTcpAgent::delay_bind_init_all();
 }
 
@@ -255,6 +344,13 @@ SackFullTcpAgent::delay_bind_dispatch(const char *varName, const char *localName
         if (delay_bind(varName, localName, "sack_block_size_", &sack_block_size_, tracer)) return TCL_OK;
         if (delay_bind(varName, localName, "sack_option_size_", &sack_option_size_, tracer)) return TCL_OK;
         if (delay_bind(varName, localName, "max_sack_blocks_", &max_sack_blocks_, tracer)) return TCL_OK;
+        if (delay_bind_bool(varName, localName, "dsack_", &dsack_, tracer)) return TCL_OK;
+        if (delay_bind_bool(varName, localName, "dsack_reorder_", &dsack_reorder_, tracer)) return TCL_OK;
+        if (delay_bind(varName, localName, "ndsack_", &ndsack_, tracer)) return TCL_OK;
+        if (delay_bind_bool(varName, localName, "tlp_", &tlp_, tracer)) return TCL_OK;
+        if (delay_bind(varName, localName, "ntlp_", &ntlp_, tracer)) return TCL_OK;
+        if (delay_bind_bool(varName, localName, "rack_", &rack_, tracer)) return TCL_OK;
+        if (delay_bind(varName, localName, "nrack_", &nrack_, tracer)) return TCL_OK;
         return FullTcpAgent::delay_bind_dispatch(varName, localName, tracer);
 }
 
@@ -272,6 +368,21 @@ FullTcpAgent::command(int argc, const char*const* argv)
 	// close is designed to happen at some point after the
 	// simulation is running (using an ns 'at' command)
 
+	/* $tcp set-pias-service service_id thresh_0 thresh_1 ... (no thresholds to clear) */
+	if (argc >= 3 && strcmp(argv[1], "set-pias-service") == 0) {
+		int sid = atoi(argv[2]);
+		int num = argc - 3;	//number of thresholds
+
+		if (sid < 0 || sid >= MAX_PIAS_SERVICE_NUM || num > MAX_PIAS_PRIO_NUM - 1) {
+			fprintf(stderr, "Invalid set-pias-service params: %s with %d thresholds\n", argv[2], num);
+			exit(1);
+		}
+		for (int i = 0; i < num; i++)
+			pias_service_thresh_[sid][i] = atoi(argv[i + 3]);
+		pias_service_prio_num_[sid] = (num > 0) ? num + 1 : 0;
+		pias_invalidate();
+		return (TCL_OK);
+	}
 	if (argc == 2) {
 		if (strcmp(argv[1], "listen") == 0) {
 			// just a state transition
@@ -296,17 +407,61 @@ FullTcpAgent::command(int argc, const char*const* argv)
 			advance_bytes(atoi(argv[2]));
 			return (TCL_OK);
 		}
+		if (strcmp(argv[1], "attach-pias-controller") == 0) {
+			pias_ctrl_ = (PiasController*)TclObject::lookup(argv[2]);
+			if (pias_ctrl_ == NULL) {
+				Tcl::instance().resultf("no such object %s", argv[2]);
+				return (TCL_ERROR);
+			}
+			return (TCL_OK);
+		}
+		if (strcmp(argv[1], "attach-grant-controller") == 0) {
+			homa_ctrl_ = (HomaGrantController*)TclObject::lookup(argv[2]);
+			if (homa_ctrl_ == NULL) {
+				Tcl::instance().resultf("no such object %s", argv[2]);
+				return (TCL_ERROR);
+			}
+			return (TCL_OK);
+		}
 		//Mohammad
 		if (strcmp(argv[1], "get-flow") == 0) {
 		        flow_remaining_ = atoi(argv[2]);
 		        return(TCL_OK);
 		}
 	}
+	/* $tcp set-class-map service_id pias_level queue (-1: default) */
+	if (argc == 5 && strcmp(argv[1], "set-class-map") == 0) {
+		int sid = atoi(argv[2]);
+		int level = atoi(argv[3]);
+		int queue = atoi(argv[4]);
+
+		if (sid < 0 || sid >= MAX_PIAS_SERVICE_NUM || level < 0 || level >= MAX_PIAS_PRIO_NUM || queue < -1) {
+			fprintf(stderr, "Invalid set-class-map params: %s %s %s\n", argv[2], argv[3], argv[4]);
+			exit(1);
+		}
+		class_map_[sid][level] = queue + 1;
+		return (TCL_OK);
+	}
 	if (argc == 4) {
 		if (strcmp(argv[1], "sendmsg") == 0) {
 			sendmsg(atoi(argv[2]), argv[3]);
 			return (TCL_OK);
 		}
+		if (strcmp(argv[1], "advance-msg") == 0) {
+			advance_msg(atoi(argv[2]), atoi(argv[3]));
+			return (TCL_OK);
+		}
+		/* $tcp set-pias-thresh level bytes, for levels beyond pias_thresh_6 */
+		if (strcmp(argv[1], "set-pias-thresh") == 0) {
+			int level = atoi(argv[2]);
+			if (level < 0 || level >= MAX_PIAS_PRIO_NUM - 1) {
+				fprintf(stderr, "Invalid set-pias-thresh params: %s %s\n", argv[2], argv[3]);
+				exit(1);
+			}
+			pias_thresh_[level] = atoi(argv[3]);
+			pias_invalidate();
+			return (TCL_OK);
+		}
 	}
 	return (TcpAgent::command(argc, argv));
 }
@@ -369,6 +524,7 @@ FullTcpAgent::advance_bytes(int nb)
 	case TCPS_LISTEN:
                 reset();
 				startseq_ = iss_;
+				pias_new_flow();
                 curseq_ = iss_ + nb;
 				seq_bound_ = -1;
 		connect();              // initiate new connection
@@ -381,6 +537,7 @@ FullTcpAgent::advance_bytes(int nb)
                         curseq_ = iss_;
 				startseq_ = curseq_;
 				seq_bound_ = -1;
+				pias_new_flow();
                 curseq_ += nb;
 		break;
 
@@ -388,9 +545,22 @@ FullTcpAgent::advance_bytes(int nb)
             if (debug_)
 	            fprintf(stderr, "%f: FullTcpAgent::advance(%s): cannot advance while in state %s\n",
 		         now(), name(), statestr(state_));
+            msg_id_ = -1;	// the message is not queued
 
 	}
 
+	if (msg_id_ >= 0) {
+		if (msg_num_ == MAX_PENDING_MSG) {
+			fprintf(stderr, "Too many pending messages on %s\n", name());
+			exit(1);
+		}
+		PendingMsg *m = &msgs_[(msg_head_ + msg_num_) % MAX_PENDING_MSG];
+		m->id = msg_id_;
+		m->start = startseq_;
+		m->end = curseq_;
+		msg_num_++;
+	}
+
         ndatabytes_=0; //Reset number of data bytes sent back to 0
 
 	if (state_ == TCPS_ESTABLISHED)
@@ -399,6 +569,19 @@ FullTcpAgent::advance_bytes(int nb)
   	return;
 }
 
+/*
+ * advance_bytes for a message with boundary: PIAS counts the bytes sent
+ * from the start of the message, and the Tcl done_msg procedure is called
+ * with its id and size once the message is fully acked.
+ */
+void
+FullTcpAgent::advance_msg(int nb, int id)
+{
+	msg_id_ = id;
+	advance_bytes(nb);
+	msg_id_ = -1;
+}
+
 /*
  * If MSG_EOF is set, by setting close_on_empty_ to TRUE, we ensure that
  * a FIN will be sent when the send buffer emptys.
@@ -420,6 +603,11 @@ printf("setting 2 closeonempty to true for fid= %d\n",fid_);
 		signal_on_empty_ = TRUE;
 		printf("setting signalonempty to true for fid= %d\n",fid_);
 	}
+	/* "MSG:id" marks a message boundary */
+	if (flags && strncmp(flags, "MSG:", 4) == 0 && nbytes >= 0) {
+		advance_msg(nbytes, atoi(flags + 4));
+		return;
+	}
 	if (nbytes == -1) {
 		infinite_send_ = TRUE;
 		advance_bytes(0);
@@ -462,6 +650,8 @@ FullTcpAgent::bufferempty()
 {
    	signal_on_empty_=FALSE;
 	//printf("flow fid= %d is done\n",fid_);
+	if (pias_ctrl_)
+		pias_ctrl_->record(serviceid_, curseq_ - startseq_);
 	Tcl::instance().evalf("%s done_data", this->name());
 }
 
@@ -531,6 +721,51 @@ FullTcpAgent::cancel_timers()
 	TcpAgent::cancel_timers();
 	// cancel: delack
 	delack_timer_.force_cancel();
+	rtx_deadline_ = delack_deadline_ = -1.0;
+	// cancel: pace
+	pace_timer_.force_cancel();
+	dcqcn_alpha_timer_.force_cancel();
+	dcqcn_rate_timer_.force_cancel();
+}
+
+void
+FullTcpAgent::set_rtx_timer()
+{
+	double delay = rtt_timeout();
+
+	rtx_deadline_ = now() + delay;
+	if (!lazy_timers_ || rtx_timer_.status() != TIMER_PENDING ||
+	    rtx_sched_ > rtx_deadline_) {
+		rtx_timer_.resched(delay);
+		rtx_sched_ = rtx_deadline_;
+	}
+}
+
+void
+FullTcpAgent::cancel_rtx_timer()
+{
+	rtx_deadline_ = -1.0;
+	if (!lazy_timers_)
+		rtx_timer_.force_cancel();
+}
+
+void
+FullTcpAgent::delack_set(double delay)
+{
+	delack_deadline_ = now() + delay;
+	if (!lazy_timers_ || delack_timer_.status() != TIMER_PENDING ||
+	    delack_sched_ > delack_deadline_) {
+		delack_timer_.resched(delay);
+		delack_sched_ = delack_deadline_;
+	}
+}
+
+void
+FullTcpAgent::delack_cancel()
+{
+	delack_deadline_ = -1.0;
+	if (!lazy_timers_)
+		delack_timer_.force_cancel();
 }
 
 void
@@ -614,6 +849,31 @@ DelAckTimer::expire(Event *) {
         a_->timeout(TCP_TIMER_DELACK);
 }
 
+void
+PaceTimer::expire(Event *) {
+        a_->timeout(TCP_TIMER_PACE);
+}
+
+void
+DcqcnAlphaTimer::expire(Event *) {
+        a_->timeout(TCP_TIMER_DCQCN_ALPHA);
+}
+
+void
+DcqcnRateTimer::expire(Event *) {
+        a_->timeout(TCP_TIMER_DCQCN_RATE);
+}
+
+void
+TlpTimer::expire(Event *) {
+        a_->timeout(TCP_TIMER_TLP);
+}
+
+void
+RackTimer::expire(Event *) {
+        a_->timeout(TCP_TIMER_RACK);
+}
+
 /*
  * reset to starting point, don't set state_ here,
  * because our starting point might be LISTEN rather
@@ -625,6 +885,22 @@ FullTcpAgent::reset()
 	cancel_timers();	// cancel timers first
       	TcpAgent::reset();	// resets most variables
 	rq_.clear();		// clear reassembly queue
+	msg_num_ = 0;		// forget unacked messages
+	dsack_left_ = dsack_right_ = -1;
+	reorder_thresh_ = 0;
+	pace_credit_ = 0;
+	pace_next_ = 0.0;
+	syn_rtt_ = -1.0;
+	int_echo_num_ = 0;
+	hpcc_nhop_ = 0;
+	hpcc_u_ = hpcc_wc_ = hpcc_w_ = 0.0;
+	hpcc_stage_ = 0;
+	hpcc_update_seq_ = -1;
+	swift_fcwnd_ = swift_ecwnd_ = swift_cwnd_ = 0.0;
+	swift_last_decrease_ = -1.0;
+	bbr_init();
+	dcqcn_init();
+	homa_init();
 	rtt_init();		// zero rtt, srtt, backoff
 	last_ack_sent_ = -1;
 	flow_remaining_ = -1; // Mohammad
@@ -751,6 +1027,9 @@ FullTcpAgent::reass(Packet* pkt)
 		abort();
 	}
 
+	if (end > start && rq_.contains(start, end))
+		dsack_note(start, end);
+
 	flags = rq_.add(start, end, tiflags, 0);
 
 	//present:
@@ -797,9 +1076,11 @@ FullTcpAgent::build_options(hdr_tcp* tcph)
 	if (ts_option_) {
 		tcph->ts() = now();
 		tcph->ts_echo() = recent_;
+		tcph->ack_delay() = (recent_age_ > 0.0) ? now() - recent_age_ : 0.0;
 		total += ts_option_size_;
 	} else {
 		tcph->ts() = tcph->ts_echo() = -1.0;
+		tcph->ack_delay() = 0.0;
 	}
 	return (total);
 }
@@ -882,20 +1163,151 @@ FullTcpAgent::calPrio(int prio) {
 	return prio_num_ - 1;
 }
 
+/*
+ * Bytes of the message of seqno sent before seqno. Segments are mostly sent
+ * in order, so we first try the message of the last segment and the next one.
+ */
+int FullTcpAgent::msg_offset(int seqno)
+{
+    PendingMsg *m = &msgs_[msg_cur_];
+
+    if (msg_num_ == 0)
+        return seqno - startseq_;
+
+    if (seqno <= m->start || seqno > m->end) {
+        int next = (msg_cur_ + 1) % MAX_PENDING_MSG;
+        int i = 0;
+
+        if (seqno > msgs_[next].start && seqno <= msgs_[next].end &&
+            (next - msg_head_ + MAX_PENDING_MSG) % MAX_PENDING_MSG < msg_num_) {
+            msg_cur_ = next;
+        } else {
+            for (i = 0; i < msg_num_; i++) {
+                int index = (msg_head_ + i) % MAX_PENDING_MSG;
+                if (seqno > msgs_[index].start && seqno <= msgs_[index].end) {
+                    msg_cur_ = index;
+                    break;
+                }
+            }
+            if (i == msg_num_)
+                return seqno - startseq_;
+        }
+        m = &msgs_[msg_cur_];
+    }
+
+    return seqno - m->start;
+}
+
+/* End of the message of seqno, the latest advance if it has no boundary */
+int FullTcpAgent::msg_end(int seqno)
+{
+    PendingMsg *m;
+
+    msg_offset(seqno);
+    m = &msgs_[msg_cur_];
+    if (msg_num_ > 0 && seqno > m->start && seqno <= m->end)
+        return m->end;
+    return curseq_;
+}
+
+/* Size of the message of seqno: it starts msg_offset(seqno) bytes before seqno */
+int FullTcpAgent::msg_size(int seqno)
+{
+    return msg_end(seqno) - seqno + msg_offset(seqno);
+}
+
+void FullTcpAgent::msg_acked()
+{
+    while (msg_num_ > 0 && highest_ack_ > msgs_[msg_head_].end) {
+        PendingMsg m = msgs_[msg_head_];
+
+        msg_head_ = (msg_head_ + 1) % MAX_PENDING_MSG;
+        msg_num_--;
+        Tcl::instance().evalf("%s done_msg %d %d", this->name(), m.id, m.end - m.start);
+    }
+}
+
+int FullTcpAgent::class_map_[MAX_PIAS_SERVICE_NUM][MAX_PIAS_PRIO_NUM];
+
+/* Queue of a data packet at a PIAS level: from the class map, or def if unset */
+int FullTcpAgent::classify(int level, int def)
+{
+    if (serviceid_ >= 0 && serviceid_ < MAX_PIAS_SERVICE_NUM && level >= 0 && level < MAX_PIAS_PRIO_NUM &&
+        class_map_[serviceid_][level] > 0)
+        return class_map_[serviceid_][level] - 1;
+
+    return def;
+}
+
+int FullTcpAgent::pias_service_prio_num_[MAX_PIAS_SERVICE_NUM];
+int FullTcpAgent::pias_service_thresh_[MAX_PIAS_SERVICE_NUM][MAX_PIAS_PRIO_NUM - 1];
+
 int FullTcpAgent::piasPrio(int bytes_sent)
 {
     if (enable_pias_ && pias_prio_num_ >= 1) {
-        pias_prio_num_ = min(pias_prio_num_, 8); //no more than 8 priorities now
-        for (int i = 0; i < pias_prio_num_ - 1; i++) {
-            if (bytes_sent <= pias_thresh_[i])
-                return i;
-        }
-        return pias_prio_num_ - 1;    //lowest priority by default
+        /* the priority only changes when bytes sent cross a threshold */
+        if (bytes_sent <= pias_lo_ || bytes_sent > pias_hi_)
+            pias_update(bytes_sent);
+        return pias_level_;
     } else {
         return 0;
     }
 }
 
+/* Thresholds of this flow: adaptive ones, those of its service, or the agent's own */
+const int* FullTcpAgent::pias_thresholds(int &levels)
+{
+    if (pias_snap_num_ > 0) {
+        levels = pias_snap_num_;
+        return pias_snap_;
+    }
+
+    if (serviceid_ >= 0 && serviceid_ < MAX_PIAS_SERVICE_NUM && pias_service_prio_num_[serviceid_] > 0) {
+        levels = pias_service_prio_num_[serviceid_];
+        return pias_service_thresh_[serviceid_];
+    }
+
+    levels = max(min(pias_prio_num_, MAX_PIAS_PRIO_NUM), 1);
+    return pias_thresh_;
+}
+
+int FullTcpAgent::pias_levels()
+{
+    int levels = 0;
+
+    pias_thresholds(levels);
+    return levels;
+}
+
+void FullTcpAgent::pias_new_flow()
+{
+    pias_invalidate();
+    if (pias_ctrl_)
+        pias_snap_num_ = pias_ctrl_->snapshot(serviceid_, pias_snap_);
+}
+
+/*
+ * Find the PIAS priority of bytes_sent: the first level whose threshold is
+ * no smaller than bytes_sent, or the lowest priority. Also cache the range
+ * of bytes sent sharing this priority.
+ */
+void FullTcpAgent::pias_update(int bytes_sent)
+{
+    int levels = 0;
+    const int *thresh = pias_thresholds(levels);
+    int i = 0;
+
+    pias_lo_ = INT_MIN;
+    for (i = 0; i < levels - 1; i++) {
+        if (bytes_sent <= thresh[i])
+            break;
+        pias_lo_ = max(pias_lo_, thresh[i]);
+    }
+
+    pias_level_ = i;
+    pias_hi_ = (i < levels - 1) ? thresh[i] : INT_MAX;
+}
+
 /*
  * sendpacket:
  *	allocate a packet, fill in header fields, and send
@@ -910,7 +1322,7 @@ int FullTcpAgent::piasPrio(int bytes_sent)
 void
 FullTcpAgent::sendpacket(int seqno, int ackno, int pflags, int datalen, int reason, Packet *p)
 {
-        if (!p) p = allocpkt();
+        if (!p) p = pool_alloc();
         hdr_tcp *tcph = hdr_tcp::access(p);
 	hdr_flags *fh = hdr_flags::access(p);
 	hdr_ip* iph = hdr_ip::access(p);
@@ -922,6 +1334,20 @@ FullTcpAgent::sendpacket(int seqno, int ackno, int pflags, int datalen, int reas
         tcph->flags() = pflags;
         tcph->reason() |= reason; // make tcph->reason look like ns1 pkt->flags?
 	tcph->sa_length() = 0;    // may be increased by build_options()
+	tcph->gso_size() = (datalen > maxseg_) ? maxseg_ : 0;
+	tcph->int_on() = ((cc_mode_ == CC_HPCC || cc_mode_ == CC_SWIFT) && datalen > 0);
+	tcph->int_nhop() = 0;
+	if (datalen == 0 && int_echo_num_ > 0) {
+		tcph->int_nhop() = int_echo_num_;
+		memcpy(&tcph->int_hop(0), int_echo_, int_echo_num_ * sizeof(IntHop));
+	}
+	tcph->cnp() = dcqcn_cnp_send_;
+	dcqcn_cnp_send_ = FALSE;
+	tcph->homa_end() = (cc_mode_ == CC_HOMA) ? msg_end(seqno) : int(curseq_);
+	tcph->homa_grant() = homa_rgrant_;
+	tcph->homa_prio() = homa_rprio_;
+	tcph->ace_ce_bytes() = accecn_ ? ace_ce_rcvd_ : 0;
+	tcph->ace_ect_bytes() = accecn_ ? ace_ect_rcvd_ : 0;
         tcph->hlen() = tcpip_base_hdr_size_;
 	tcph->hlen() += build_options(tcph);
 	//Shuang: reduce header length
@@ -960,6 +1386,9 @@ FullTcpAgent::sendpacket(int seqno, int ackno, int pflags, int datalen, int reas
 		pflags |= TH_ECE;
 
 	}
+	// AccECN: the counters carry the marks, ECE is sent once
+	if (accecn_)
+		recent_ce_ = FALSE;
         // fill in CWR and ECE bits which don't actually sit in
         // the tcp_flags but in hdr_flags
         if ( pflags & TH_ECE) {
@@ -992,7 +1421,8 @@ FullTcpAgent::sendpacket(int seqno, int ackno, int pflags, int datalen, int reas
                 ndatabytes_ += datalen;
 		last_send_time_ = now();	// time of last data
         }
-        if (reason == REASON_TIMEOUT || reason == REASON_DUPACK || reason == REASON_SACK) {
+        if (reason == REASON_TIMEOUT || reason == REASON_DUPACK || reason == REASON_SACK ||
+	    reason == REASON_TRIM || reason == REASON_TLP) {
                 ++nrexmitpack_;
                 nrexmitbytes_ += datalen;
         }
@@ -1049,24 +1479,42 @@ FullTcpAgent::sendpacket(int seqno, int ackno, int pflags, int datalen, int reas
     {
         if (datalen > 0)
         {
-            iph->prio() = piasPrio(seqno-startseq_);
+            int bytes_sent = msg_offset(seqno);
+            iph->prio() = piasPrio(bytes_sent);
             if (pias_debug_)
-                printf("Packet prio is %d when bytes sent is %d\n", iph->prio(), seqno - startseq_);
+                printf("Packet prio is %d when bytes sent is %d\n", iph->prio(), bytes_sent);
         }
         else    //highest priority by default
         {
             iph->prio() = 0;
         }
 
+        int level = iph->prio();
+
         //We classify different services in the lowest priority
-        if (iph->prio() == pias_prio_num_ - 1)
+        if (level == pias_levels() - 1)
             iph->prio() = serviceid_;
+        //The class map overrides this layout for data packets
+        if (datalen > 0)
+            iph->prio() = classify(level, iph->prio());
     }
     else
     {
         iph->prio() = serviceid_;
+        if (datalen > 0)
+            iph->prio() = classify(0, serviceid_);
     }
 
+	/* Homa: unscheduled data by message size, the rest as granted */
+	if (cc_mode_ == CC_HOMA) {
+		if (datalen == 0)
+			iph->prio() = 0;
+		else if (msg_offset(seqno) < homa_rtt_bytes_ || homa_prio_ < 0)
+			iph->prio() = homa_unsched_prio(msg_size(seqno));
+		else
+			iph->prio() = homa_prio_;
+	}
+
 	send(p, 0);
 
 	return;
@@ -1178,7 +1626,11 @@ FullTcpAgent::foutput(int seqno, int reason)
 	if (datalen < 0) {
 		datalen = 0;
 	} else if (datalen > maxseg_) {
-		datalen = maxseg_;
+		// only new data in a window goes out as a super-segment
+		if (is_retransmit || syn || pipectrl_)
+			datalen = maxseg_;
+		else
+			datalen = min(datalen, tso_limit(seqno));
 	}
 
 
@@ -1230,7 +1682,7 @@ FullTcpAgent::foutput(int seqno, int reason)
 
 	if (datalen > 0) {
 		// if full-sized segment, ok
-		if (datalen == maxseg_)
+		if (datalen >= maxseg_)
 			goto send;
 		// if Nagle disabled and buffer clearing, ok
 		if ((quiet || nodelay_)  && emptying_buffer)
@@ -1334,6 +1786,12 @@ send:
                 }
         }
 	sendpacket(seqno, rcv_nxt_, pflags, datalen, reason);
+	if (datalen > 0) {
+		if (cc_mode_ == CC_BBR)
+			bbr_sent(seqno, datalen);
+		else if (cc_mode_ == CC_DCQCN)
+			dcqcn_sent(datalen);
+	}
 
         /*
          * Data sent (as far as we can tell).
@@ -1342,7 +1800,7 @@ send:
 	flags_ &= ~(TF_ACKNOW|TF_DELACK);
 
 	// Mohammad
-	delack_timer_.force_cancel();
+	delack_cancel();
 	/*
 	if (datalen == 0)
 	        printf("%f -- %s sent ACK for %d, canceled delack\n", this->name(), Scheduler::instance().clock(), rcv_nxt_);
@@ -1392,9 +1850,11 @@ send:
 	 * round-trip time + 2 * round-trip time variance.
 	 * Future values are rtt + 4 * rttvar.
 	 */
-	if (rtx_timer_.status() != TIMER_PENDING && reliable) {
+	if (!rtx_pending() && reliable) {
 		set_rtx_timer();  // no timer pending, schedule one
 	}
+	if (datalen > 0)
+		tx_stamp(seqno, datalen);
 
 	return (reliable);
 }
@@ -1423,6 +1883,10 @@ FullTcpAgent::send_much(int force, int reason, int maxburst)
 	if (!force && (delsnd_timer_.status() == TIMER_PENDING))
 		return;
 
+	// a flow starting or restarting from idle may send a burst
+	if (pace_gain() > 0.0 && highest_ack_ == maxseq_)
+		pace_credit_ = pace_burst_;
+
 	while (1) {
 
 		/*
@@ -1443,6 +1907,12 @@ FullTcpAgent::send_much(int force, int reason, int maxburst)
 			delsnd_timer_.resched(Random::uniform(overhead_));
 			return;
 		}
+		if (!force && pace_gain() > 0.0 && pace_credit_ <= 0 &&
+		    now() < pace_next_) {
+			if (pace_timer_.status() != TIMER_PENDING)
+				pace_timer_.resched(pace_next_ - now());
+			return;
+		}
 		if ((amt = foutput(seq, reason)) <= 0) {
 		  //printf("made call to foutput: returned %d\n", amt);
 		        break;
@@ -1450,6 +1920,8 @@ FullTcpAgent::send_much(int force, int reason, int maxburst)
 		if ((outflags() & TH_FIN))
 			--amt;	// don't count FINs
 		sent(seq, amt);
+		if (pace_gain() > 0.0)
+			pace_sent(amt);
 		force = 0;
 
 		if ((outflags() & (TH_SYN|TH_FIN)) ||
@@ -1459,6 +1931,615 @@ FullTcpAgent::send_much(int force, int reason, int maxburst)
 	return;
 }
 
+double
+FullTcpAgent::pace_rtt()
+{
+	if (cc_mode_ == CC_HPCC && hpcc_rtt() > 0)
+		return (hpcc_rtt());
+	if (cc_mode_ == CC_BBR && bbr_min_rtt_ > 0)
+		return (bbr_min_rtt_);
+	if (rtt_srtt() > 0)
+		return (rtt_srtt());
+	return (syn_rtt_);
+}
+
+double
+FullTcpAgent::pace_wnd()
+{
+	if (cc_mode_ == CC_HPCC && hpcc_w_ > 0.0)
+		return (hpcc_w_);
+	if (cc_mode_ == CC_SWIFT && swift_cwnd_ > 0.0)
+		return (swift_cwnd_ * maxseg_);
+	if (cc_mode_ == CC_BBR && bbr_bdp(1.0) > 0.0)
+		return (bbr_bdp(1.0));
+	return (double(cwnd_) * maxseg_);
+}
+
+double
+FullTcpAgent::pace_gain()
+{
+	if (cc_mode_ == CC_BBR)
+		return (bbr_pacing_gain());
+	if (cc_mode_ == CC_DCQCN)
+		return (1.0);
+	if (pace_gain_ > 0.0)
+		return (pace_gain_);
+	/* Swift paces only a window below one segment */
+	if (cc_mode_ == CC_SWIFT && swift_cwnd_ > 0.0 && swift_cwnd_ < 1.0)
+		return (1.0);
+	return (0.0);
+}
+
+/*
+ * After amt bytes went out, the next segment may leave amt bytes
+ * later at the pacing rate. Time not used by an ACK clocked flow
+ * is not saved up for a later burst.
+ */
+void
+FullTcpAgent::pace_sent(int amt)
+{
+	double rate = pace_rate();
+
+	if (pace_credit_ > 0) {
+		pace_credit_--;
+		pace_next_ = now();
+		return;
+	}
+	if (rate <= 0.0) {
+		pace_next_ = now();
+		return;
+	}
+	pace_next_ = max(pace_next_, now()) + amt / rate;
+}
+
+double
+FullTcpAgent::pace_rate()
+{
+	double rtt = pace_rtt();
+
+	if (cc_mode_ == CC_DCQCN)
+		return (dcqcn_rc_ / 8);
+	if (rtt <= 0.0 || pace_wnd() <= 0.0)
+		return (0.0);
+	return (pace_gain() * pace_wnd() / rtt);
+}
+
+void
+FullTcpAgent::int_save(hdr_tcp *tcph)
+{
+	int_echo_num_ = min(tcph->int_nhop(), MAX_INT_HOPS);
+	memcpy(int_echo_, &tcph->int_hop(0), int_echo_num_ * sizeof(IntHop));
+}
+
+double
+FullTcpAgent::hpcc_rtt()
+{
+	return (hpcc_base_rtt_ > 0.0 ? hpcc_base_rtt_ : rtt_min());
+}
+
+/*
+ * Utilization of each hop since the last ACK: its queue in units of
+ * T's worth of bytes plus its tx rate over capacity. hpcc_u_ moves
+ * to the largest one in proportion to the time it covers.
+ */
+int
+FullTcpAgent::hpcc_util(hdr_tcp *tcph, double T)
+{
+	int n = min(tcph->int_nhop(), MAX_INT_HOPS);
+	int sampled = FALSE;
+	double u = 0.0, tau = T;
+
+	for (int i = 0; i < n && n == hpcc_nhop_; i++) {
+		IntHop& cur = tcph->int_hop(i);
+		IntHop& last = hpcc_hop_[i];
+		double dt = cur.ts - last.ts;
+
+		if (dt <= 0.0 || cur.rate <= 0.0)
+			continue;
+		double txrate = (cur.txbytes - last.txbytes) * 8 / dt;
+		double ui = min(cur.qlen, last.qlen) * 8 / (cur.rate * T) + txrate / cur.rate;
+		if (!sampled || ui > u) {
+			u = ui;
+			tau = dt;
+		}
+		sampled = TRUE;
+	}
+	hpcc_nhop_ = n;
+	memcpy(hpcc_hop_, &tcph->int_hop(0), n * sizeof(IntHop));
+	if (!sampled)
+		return (FALSE);
+
+	if (tau > T)
+		tau = T;
+	hpcc_u_ = (1 - tau / T) * hpcc_u_ + tau / T * u;
+	return (TRUE);
+}
+
+/*
+ * HPCC window update on an ACK with INT. The window starts at, and
+ * never exceeds, T at the slowest hop's capacity.
+ */
+void
+FullTcpAgent::hpcc_ack(hdr_tcp *tcph)
+{
+	double T = hpcc_rtt();
+	double wmax = 0.0, w = 0.0;
+	int update = (tcph->ackno() > hpcc_update_seq_);
+
+	if (T <= 0.0)
+		return;
+	for (int i = 0; i < min(tcph->int_nhop(), MAX_INT_HOPS); i++) {
+		double bdp = tcph->int_hop(i).rate * T / 8;
+		if (wmax <= 0.0 || bdp < wmax)
+			wmax = bdp;
+	}
+	if (!hpcc_util(tcph, T) || wmax <= 0.0)
+		return;
+	if (hpcc_wc_ <= 0.0)
+		hpcc_wc_ = wmax;
+
+	if (hpcc_u_ >= hpcc_eta_ || hpcc_stage_ >= hpcc_max_stage_) {
+		w = (hpcc_u_ > 0.0) ? hpcc_wc_ * hpcc_eta_ / hpcc_u_ + hpcc_wai_ : wmax;
+		if (update)
+			hpcc_stage_ = 0;
+	} else {
+		w = hpcc_wc_ + hpcc_wai_;
+		if (update)
+			hpcc_stage_++;
+	}
+	w = max(min(w, wmax), hpcc_wai_);
+	if (update) {
+		hpcc_wc_ = w;
+		hpcc_update_seq_ = maxseq_;
+	}
+
+	hpcc_w_ = w;
+	cwnd_ = max(w / maxseg_, 1.0);
+}
+
+/*
+ * Swift target: base, plus a delay per hop, plus a flow scaling term
+ * that falls from swift_fs_range_ at fs_min_cwnd_ to 0 at fs_max_cwnd_
+ * as 1/sqrt(window).
+ */
+double
+FullTcpAgent::swift_target(int hops)
+{
+	double t = swift_base_target_ + hops * swift_hop_scale_;
+
+	if (swift_fs_range_ > 0.0 && swift_fs_min_cwnd_ > 0.0 &&
+	    swift_fs_max_cwnd_ > swift_fs_min_cwnd_ && swift_fcwnd_ > 0.0) {
+		double a = swift_fs_range_ /
+		    (1 / sqrt(swift_fs_min_cwnd_) - 1 / sqrt(swift_fs_max_cwnd_));
+		double fs = a / sqrt(swift_fcwnd_) - a / sqrt(swift_fs_max_cwnd_);
+		t += max(0.0, min(fs, swift_fs_range_));
+	}
+	return (t);
+}
+
+/* one AIMD step of a Swift window for n segments acked */
+double
+FullTcpAgent::swift_aimd(double w, double delay, double target, double n, int& decreased)
+{
+	if (delay < target) {
+		w += (w >= 1.0) ? swift_ai_ * n / w : swift_ai_ * n;
+	} else if (swift_last_decrease_ < 0.0 ||
+		   now() - swift_last_decrease_ >= rtt_srtt()) {
+		w *= max(1 - swift_beta_ * (delay - target) / delay, 1 - swift_max_mdf_);
+		decreased = TRUE;
+	}
+	return (max(min(w, double(wnd_)), swift_min_cwnd_));
+}
+
+void
+FullTcpAgent::swift_ack(hdr_tcp *tcph, int acked)
+{
+	double rtt = rtt_last();
+	double host = max(tcph->ack_delay(), 0.0);
+	int hops = (tcph->int_nhop() > 0) ? tcph->int_nhop() : swift_hops_;
+	int decreased = FALSE;
+
+	if (rtt <= 0.0 || acked <= 0)
+		return;
+	if (swift_fcwnd_ <= 0.0)
+		swift_fcwnd_ = swift_ecwnd_ = cwnd_;
+
+	swift_fcwnd_ = swift_aimd(swift_fcwnd_, rtt - host, swift_target(hops),
+	    double(acked) / maxseg_, decreased);
+	if (swift_host_target_ > 0.0)
+		swift_ecwnd_ = swift_aimd(swift_ecwnd_, host, swift_host_target_,
+		    double(acked) / maxseg_, decreased);
+	else
+		swift_ecwnd_ = swift_fcwnd_;
+	if (decreased)
+		swift_last_decrease_ = now();
+
+	swift_cwnd_ = min(swift_fcwnd_, swift_ecwnd_);
+	cwnd_ = max(swift_cwnd_, 1.0);
+}
+
+/* a loss takes the largest decrease, at most once per RTT */
+void
+FullTcpAgent::swift_loss()
+{
+	if (swift_fcwnd_ <= 0.0)
+		return;
+	if (swift_last_decrease_ < 0.0 || now() - swift_last_decrease_ >= rtt_srtt()) {
+		swift_fcwnd_ = max(swift_fcwnd_ * (1 - swift_max_mdf_), swift_min_cwnd_);
+		swift_ecwnd_ = max(swift_ecwnd_ * (1 - swift_max_mdf_), swift_min_cwnd_);
+		swift_last_decrease_ = now();
+	}
+	swift_cwnd_ = min(swift_fcwnd_, swift_ecwnd_);
+	cwnd_ = max(swift_cwnd_, 1.0);
+}
+
+/* PROBE_BW pacing gains: probe up, drain the queue, then cruise */
+static const double bbr_cycle_gain[BBR_CYCLE_LEN] = {
+	1.25, 0.75, 1, 1, 1, 1, 1, 1
+};
+
+void
+FullTcpAgent::bbr_init()
+{
+	bbr_txq_.clear();
+	bbr_state_ = BBR_STARTUP;
+	bbr_delivered_ = 0;
+	bbr_delivered_ts_ = bbr_first_ts_ = 0.0;
+	bbr_app_limited_ = 0;
+	memset(bbr_bw_, 0, sizeof(bbr_bw_));
+	bbr_round_ = 0;
+	bbr_next_round_delivered_ = 0;
+	bbr_full_bw_ = 0.0;
+	bbr_full_bw_cnt_ = 0;
+	bbr_filled_pipe_ = FALSE;
+	bbr_min_rtt_ = bbr_min_rtt_ts_ = -1.0;
+	bbr_cycle_idx_ = 0;
+	bbr_cycle_ts_ = 0.0;
+	bbr_probe_rtt_done_ = -1.0;
+	bbr_probe_rtt_round_done_ = FALSE;
+	bbr_prior_cwnd_ = 0.0;
+}
+
+double
+FullTcpAgent::bbr_max_bw()
+{
+	int n = max(1, min(bbr_bw_rounds_, MAX_BBR_BW_ROUNDS));
+	double bw = 0.0;
+
+	for (int i = 0; i < n; i++)
+		bw = max(bw, bbr_bw_[i]);
+	return (bw);
+}
+
+double
+FullTcpAgent::bbr_bdp(double gain)
+{
+	double bw = bbr_max_bw();
+
+	if (bw <= 0.0 || bbr_min_rtt_ <= 0.0)
+		return (-1.0);
+	return (gain * bw * bbr_min_rtt_);
+}
+
+double
+FullTcpAgent::bbr_pacing_gain()
+{
+	switch (bbr_state_) {
+	case BBR_STARTUP:
+		return (bbr_high_gain_);
+	case BBR_DRAIN:
+		return (1 / bbr_high_gain_);
+	case BBR_PROBE_BW:
+		return (bbr_cycle_gain[bbr_cycle_idx_]);
+	}
+	return (1.0);
+}
+
+void
+FullTcpAgent::bbr_set_state(int state)
+{
+	bbr_state_ = state;
+	if (state == BBR_PROBE_BW) {
+		/* start anywhere but in the drain phase */
+		bbr_cycle_idx_ = Random::integer(BBR_CYCLE_LEN - 1);
+		if (bbr_cycle_idx_ >= 1)
+			bbr_cycle_idx_++;
+		bbr_cycle_ts_ = now();
+	} else if (state == BBR_PROBE_RTT) {
+		bbr_prior_cwnd_ = cwnd_;
+		bbr_probe_rtt_done_ = -1.0;
+	}
+}
+
+void
+FullTcpAgent::bbr_sent(int seq, int len)
+{
+	TxState tx;
+
+	/* nothing in flight: the sample starts now */
+	if (bbr_txq_.empty())
+		bbr_first_ts_ = bbr_delivered_ts_ = now();
+	if (!infinite_send_ && seq + len >= curseq_)
+		bbr_app_limited_ = max(bbr_delivered_ + int(maxseq_ - highest_ack_), 1);
+
+	tx.delivered = bbr_delivered_;
+	tx.delivered_ts = bbr_delivered_ts_;
+	tx.first_ts = bbr_first_ts_;
+	tx.app_limited = (bbr_app_limited_ != 0);
+	bbr_txq_.sent(seq, len, maxseg_, now(), &tx);
+}
+
+/*
+ * The rate sample covers the data delivered since the acked segment
+ * was sent, over the longer of its send and ACK intervals.
+ */
+void
+FullTcpAgent::bbr_ack(int ackno, int acked)
+{
+	TxState tx = { 0, 0.0, 0.0, 0 };
+	double ts = 0.0, rtt = -1.0;
+	int end = 0, rexmit = 0, round_start = FALSE;
+	int n = max(1, min(bbr_bw_rounds_, MAX_BBR_BW_ROUNDS));
+	int expired = (bbr_min_rtt_ts_ >= 0.0 && now() - bbr_min_rtt_ts_ > min_rtt_win_);
+	int inflight = maxseq_ - highest_ack_;
+	double target = 0.0;
+
+	if (acked <= 0)
+		return;
+	bbr_delivered_ += acked;
+	bbr_delivered_ts_ = now();
+
+	if (bbr_txq_.lookup(ackno - 1, ts, end, rexmit, &tx)) {
+		double interval = max(ts - tx.first_ts, now() - tx.delivered_ts);
+
+		bbr_first_ts_ = ts;
+		if (!rexmit)
+			rtt = now() - ts;
+		if (tx.delivered >= bbr_next_round_delivered_) {
+			bbr_next_round_delivered_ = bbr_delivered_;
+			bbr_round_++;
+			bbr_bw_[bbr_round_ % n] = 0.0;
+			round_start = TRUE;
+		}
+		if (interval > 0.0) {
+			double bw = (bbr_delivered_ - tx.delivered) / interval;
+			if (!tx.app_limited || bw >= bbr_max_bw())
+				bbr_bw_[bbr_round_ % n] = max(bbr_bw_[bbr_round_ % n], bw);
+		}
+	}
+	bbr_txq_.clearto(ackno);
+	if (bbr_app_limited_ && bbr_delivered_ > bbr_app_limited_)
+		bbr_app_limited_ = 0;
+
+	if (rtt > 0.0 && (bbr_min_rtt_ < 0.0 || rtt <= bbr_min_rtt_ || expired)) {
+		bbr_min_rtt_ = rtt;
+		bbr_min_rtt_ts_ = now();
+	}
+
+	/* STARTUP ends when the bandwidth grew less than 25% in 3 rounds */
+	if (round_start && !bbr_filled_pipe_ && !tx.app_limited) {
+		if (bbr_max_bw() >= bbr_full_bw_ * 1.25) {
+			bbr_full_bw_ = bbr_max_bw();
+			bbr_full_bw_cnt_ = 0;
+		} else if (++bbr_full_bw_cnt_ >= 3) {
+			bbr_filled_pipe_ = TRUE;
+		}
+	}
+	if (bbr_state_ == BBR_STARTUP && bbr_filled_pipe_)
+		bbr_set_state(BBR_DRAIN);
+	if (bbr_state_ == BBR_DRAIN && inflight <= bbr_bdp(1.0))
+		bbr_set_state(BBR_PROBE_BW);
+
+	/* a phase lasts a min RTT; draining ends early at the BDP */
+	if (bbr_state_ == BBR_PROBE_BW && bbr_min_rtt_ > 0.0 &&
+	    (now() - bbr_cycle_ts_ > bbr_min_rtt_ ||
+	     (bbr_cycle_gain[bbr_cycle_idx_] < 1.0 && inflight <= bbr_bdp(1.0)))) {
+		bbr_cycle_idx_ = (bbr_cycle_idx_ + 1) % BBR_CYCLE_LEN;
+		bbr_cycle_ts_ = now();
+	}
+
+	if (bbr_state_ != BBR_PROBE_RTT && expired)
+		bbr_set_state(BBR_PROBE_RTT);
+	if (bbr_state_ == BBR_PROBE_RTT) {
+		if (bbr_probe_rtt_done_ < 0.0 && inflight <= bbr_min_cwnd_ * maxseg_) {
+			bbr_probe_rtt_done_ = now() + bbr_probe_rtt_time_;
+			bbr_probe_rtt_round_done_ = FALSE;
+			bbr_next_round_delivered_ = bbr_delivered_;
+		} else if (bbr_probe_rtt_done_ >= 0.0) {
+			if (round_start)
+				bbr_probe_rtt_round_done_ = TRUE;
+			if (bbr_probe_rtt_round_done_ && now() >= bbr_probe_rtt_done_) {
+				bbr_min_rtt_ts_ = now();
+				cwnd_ = max(double(cwnd_), bbr_prior_cwnd_);
+				bbr_set_state(bbr_filled_pipe_ ? BBR_PROBE_BW : BBR_STARTUP);
+			}
+		}
+	}
+
+	/* cwnd_: grow by what was acked, up to the target */
+	if (bbr_state_ == BBR_PROBE_RTT) {
+		cwnd_ = min(double(cwnd_), double(bbr_min_cwnd_));
+	} else {
+		target = bbr_bdp(bbr_state_ == BBR_PROBE_BW ? bbr_cwnd_gain_ : bbr_high_gain_);
+		cwnd_ = cwnd_ + double(acked) / maxseg_;
+		/* 3 more segments allow for delayed and TSO ACKs */
+		if (target >= 0.0)
+			cwnd_ = min(double(cwnd_), max(target / maxseg_ + 3, initial_window()));
+	}
+	cwnd_ = max(double(cwnd_), double(bbr_min_cwnd_));
+}
+
+void
+FullTcpAgent::dcqcn_init()
+{
+	dcqcn_rc_ = dcqcn_rt_ = dcqcn_line_rate_;
+	dcqcn_alpha_ = 1.0;
+	dcqcn_cnp_seen_ = FALSE;
+	dcqcn_bytes_ = dcqcn_t_cnt_ = dcqcn_b_cnt_ = 0;
+	dcqcn_cnp_send_ = FALSE;
+	dcqcn_cnp_last_ = -1.0;
+}
+
+/* the window does not limit a rate based sender */
+int
+FullTcpAgent::window()
+{
+	if (cc_mode_ == CC_DCQCN || cc_mode_ == CC_HOMA)
+		return (int(wnd_));
+	return (TcpAgent::window());
+}
+
+void
+FullTcpAgent::dcqcn_ce()
+{
+	if (dcqcn_cnp_last_ >= 0.0 && now() - dcqcn_cnp_last_ < dcqcn_cnp_interval_)
+		return;
+	dcqcn_cnp_last_ = now();
+	dcqcn_cnp_send_ = TRUE;
+	flags_ |= TF_ACKNOW;
+}
+
+void
+FullTcpAgent::dcqcn_cnp()
+{
+	++ncnp_;
+	dcqcn_rt_ = dcqcn_rc_;
+	dcqcn_rc_ = max(dcqcn_rc_ * (1 - dcqcn_alpha_ / 2), dcqcn_min_rate_);
+	dcqcn_alpha_ = (1 - dcqcn_g_) * dcqcn_alpha_ + dcqcn_g_;
+	dcqcn_cnp_seen_ = TRUE;
+	dcqcn_bytes_ = dcqcn_t_cnt_ = dcqcn_b_cnt_ = 0;
+
+	if (dcqcn_alpha_timer_.status() != TIMER_PENDING)
+		dcqcn_alpha_timer_.resched(dcqcn_alpha_interval_);
+	dcqcn_rate_timer_.resched(dcqcn_rate_interval_);
+}
+
+/* the byte counter runs only while the rate is below line rate */
+void
+FullTcpAgent::dcqcn_sent(int len)
+{
+	if (dcqcn_rc_ >= dcqcn_line_rate_)
+		return;
+	dcqcn_bytes_ += len;
+	if (dcqcn_byte_thresh_ > 0 && dcqcn_bytes_ >= dcqcn_byte_thresh_) {
+		dcqcn_bytes_ = 0;
+		dcqcn_b_cnt_++;
+		dcqcn_increase();
+	}
+}
+
+void
+FullTcpAgent::dcqcn_increase()
+{
+	int lo = min(dcqcn_t_cnt_, dcqcn_b_cnt_);
+	int hi = max(dcqcn_t_cnt_, dcqcn_b_cnt_);
+
+	if (lo > dcqcn_f_)
+		dcqcn_rt_ += (lo - dcqcn_f_) * dcqcn_rhai_;	// hyper increase
+	else if (hi >= dcqcn_f_)
+		dcqcn_rt_ += dcqcn_rai_;	// additive increase
+	dcqcn_rt_ = min(dcqcn_rt_, dcqcn_line_rate_);
+	dcqcn_rc_ = min((dcqcn_rt_ + dcqcn_rc_) / 2, dcqcn_line_rate_);
+}
+
+/* both timers stop once the rate is back at line rate */
+void
+FullTcpAgent::dcqcn_timeout(int tno)
+{
+	if (tno == TCP_TIMER_DCQCN_ALPHA) {
+		if (!dcqcn_cnp_seen_)
+			dcqcn_alpha_ = (1 - dcqcn_g_) * dcqcn_alpha_;
+		dcqcn_cnp_seen_ = FALSE;
+		if (dcqcn_rc_ < dcqcn_line_rate_)
+			dcqcn_alpha_timer_.resched(dcqcn_alpha_interval_);
+		return;
+	}
+	dcqcn_t_cnt_++;
+	dcqcn_increase();
+	if (dcqcn_rc_ < dcqcn_line_rate_)
+		dcqcn_rate_timer_.resched(dcqcn_rate_interval_);
+}
+
+void
+FullTcpAgent::homa_init()
+{
+	if (homa_ctrl_)
+		homa_ctrl_->update(this, 0);
+	homa_grant_ = homa_prio_ = -1;
+	homa_end_ = homa_rcvd_ = 0;
+	homa_rgrant_ = homa_rprio_ = -1;
+}
+
+/*
+ * Messages of a connection arrive in order, so the latest message end
+ * is that of the message being received, and the grants never go past it.
+ */
+void
+FullTcpAgent::homa_data(hdr_tcp *tcph, int datalen)
+{
+	homa_end_ = max(homa_end_, tcph->homa_end());
+	homa_rcvd_ = max(homa_rcvd_, max(int(rcv_nxt_), tcph->seqno() + datalen));
+	if (homa_ctrl_)
+		homa_ctrl_->update(this, homa_end_ - homa_rcvd_);
+	else
+		homa_grant(0);
+}
+
+int
+FullTcpAgent::homa_grant(int rank)
+{
+	int grant = min(homa_rcvd_ + homa_rtt_bytes_, homa_end_);
+	int prio = min(pias_levels() + rank, homa_prio_num_ - 1);
+
+	if (grant <= homa_rgrant_ && prio == homa_rprio_)
+		return (FALSE);
+	homa_rgrant_ = max(homa_rgrant_, grant);
+	homa_rprio_ = prio;
+	flags_ |= TF_ACKNOW;
+	return (TRUE);
+}
+
+void
+FullTcpAgent::homa_send_grant()
+{
+	send_much(1, REASON_NORMAL, maxburst_);
+}
+
+int
+FullTcpAgent::homa_ack(hdr_tcp *tcph)
+{
+	int moved = (tcph->homa_grant() > homa_grant_);
+
+	if (tcph->homa_grant() >= homa_grant_ && tcph->homa_prio() >= 0) {
+		homa_grant_ = tcph->homa_grant();
+		homa_prio_ = tcph->homa_prio();
+	}
+	return (moved);
+}
+
+/*
+ * Sender: seq is in the unscheduled prefix of its message, or granted.
+ * A grant covers the message being received only, which ends it.
+ */
+int
+FullTcpAgent::homa_allowed(int seq)
+{
+	return (seq < homa_grant_ || msg_offset(seq) < homa_rtt_bytes_);
+}
+
+/* first PIAS level whose threshold the message size does not exceed */
+int
+FullTcpAgent::homa_unsched_prio(int size)
+{
+	int levels = 0;
+	const int *thresh = pias_thresholds(levels);
+
+	for (int i = 0; i < levels - 1; i++)
+		if (size <= thresh[i])
+			return (i);
+	return (levels - 1);
+}
+
 /*
  * base TCP: we are allowed to send a sequence number if it
  * is in the window
@@ -1474,6 +2555,8 @@ FullTcpAgent::send_allowed(int seq)
 
         if ((topwin > highest_ack_ + win) || infinite_send_)
                 topwin = highest_ack_ + win;
+	if (cc_mode_ == CC_HOMA && !homa_allowed(seq))
+		return (FALSE);
 
 //	if (seq >= topwin) {
 //		printf("%.5lf: fid %d send not allowed\n", now(), fid_);
@@ -1481,6 +2564,123 @@ FullTcpAgent::send_allowed(int seq)
 //	}
 	return (seq < topwin);
 }
+
+/*
+ * Largest segment that may start at seqno: tso_segs_ MSS, cut so that
+ * each MSS piece starts in the same message and PIAS priority as the
+ * first one, as the GsoSegmenter copies the priority to all of them.
+ */
+int
+FullTcpAgent::tso_limit(int seqno)
+{
+	int segs = min(tso_segs_, MAX_TSO_SEGS);
+
+	if (segs <= 1 || deadline > 0)
+		return (maxseg_);
+
+	if (enable_pias_) {
+		int off = msg_offset(seqno);
+		PendingMsg *m = &msgs_[msg_cur_];
+
+		piasPrio(off);
+		if (off > pias_lo_ && off <= pias_hi_ && pias_hi_ < INT_MAX)
+			segs = min(segs, (pias_hi_ - off) / maxseg_ + 1);
+		if (msg_num_ > 0 && seqno > m->start && seqno <= m->end)
+			segs = min(segs, (m->end - seqno) / maxseg_ + 1);
+	}
+	return (segs * maxseg_);
+}
+
+/*
+ * allocpkt() for the send path. A pooled packet gets all its headers from
+ * a template packet of this connection in a single copy, instead of being
+ * zeroed and initialized field by field. The template is rebuilt when any
+ * field that initpkt() takes from the agent changes: packet type, source
+ * and destination address and port, flow id, priority and TTL. The uid
+ * and timestamp are set here; sendpacket() sets the size, the priority
+ * and the TCP and flags headers of every packet.
+ */
+Packet*
+FullTcpAgent::pool_alloc()
+{
+	Packet *p = NULL;
+	hdr_cmn *ch = NULL;
+	hdr_ip *iph = NULL;
+
+	if (pkt_pool_num_ == 0)
+		return (allocpkt());
+
+	if (pkt_tmpl_)
+		iph = hdr_ip::access(pkt_tmpl_);
+	if (!pkt_tmpl_ || hdr_cmn::access(pkt_tmpl_)->ptype() != type_ ||
+	    iph->saddr() != addr() || iph->sport() != port() ||
+	    iph->daddr() != daddr() || iph->dport() != dport() ||
+	    iph->flowid() != fid_ || iph->prio() != prio_ ||
+	    iph->ttl() != defttl_) {
+		if (pkt_tmpl_)
+			Packet::free(pkt_tmpl_);
+		pkt_tmpl_ = allocpkt();
+	}
+
+	p = pkt_pool_[--pkt_pool_num_];
+	memcpy(p->bits(), pkt_tmpl_->bits(), Packet::hdrlen_);
+	ch = hdr_cmn::access(p);
+	ch->uid() = uidcnt_++;
+	ch->timestamp() = Scheduler::instance().clock();
+	p->uid_ = 0;
+	p->time_ = 0;
+	p->next_ = 0;
+	return (p);
+}
+
+/*
+ * Keep a received packet for pool_alloc(), unless the pool is full
+ * or the packet is shared or carries data
+ */
+void
+FullTcpAgent::pool_free(Packet *p)
+{
+	if (pkt_pool_num_ < min(pkt_pool_size_, MAX_PKT_POOL_SIZE) &&
+	    p->userdata() == 0 && p->ref_count() == 0)
+		pkt_pool_[pkt_pool_num_++] = p;
+	else
+		Packet::free(p);
+}
+
+void
+FullTcpAgent::pool_clear()
+{
+	while (pkt_pool_num_ > 0)
+		Packet::free(pkt_pool_[--pkt_pool_num_]);
+	if (pkt_tmpl_)
+		Packet::free(pkt_tmpl_);
+	pkt_tmpl_ = NULL;
+}
+
+/*
+ * Packet trimming: send a pure ACK carrying the seq # of a trimmed segment
+ */
+void
+FullTcpAgent::send_nack(int seqno)
+{
+	Packet *p = pool_alloc();
+	hdr_tcp::access(p)->nackno() = seqno;
+	sendpacket(t_seqno_, rcv_nxt_, TH_ACK|TH_NACK, 0, REASON_NORMAL, p);
+}
+
+/*
+ * Packet trimming: retransmit a NACKed segment immediately,
+ * unless it has been cumulatively ACKed in the meantime
+ */
+void
+FullTcpAgent::trim_rexmit(int seqno)
+{
+	if (seqno < highest_ack_ || seqno >= maxseq_)
+		return;
+	++ntrimrexmit_;
+	(void)foutput(seqno, REASON_TRIM);
+}
+
 /*
  * Process an ACK
  *	this version of the routine doesn't necessarily
@@ -1517,6 +2717,8 @@ FullTcpAgent::newack(Packet* pkt)
 	// advance the ack number if this is for new data
 	if (progress) {
 		highest_ack_ = ackno;
+		if (msg_num_ > 0)
+			msg_acked();
 	}
 
 	// if we have suffered a retransmit timeout, t_seqno_
@@ -1632,6 +2834,8 @@ FullTcpAgent::fast_retransmit(int seq)
 	printf("%f: fid %d did a fast retransmit - dupacks = %d\n", now(), fid_, (int)dupacks_);
 	recover_ = maxseq_;	// recovery target
 	last_cwnd_action_ = CWND_ACTION_DUPACK;
+	if (cc_mode_ == CC_SWIFT)
+		swift_loss();
 	return(foutput(seq, REASON_DUPACK));	// send one pkt
 }
 
@@ -1657,12 +2861,31 @@ FullTcpAgent::need_send()
 
 	int spa = (spa_thresh_ > 0 && ((rcv_nxt_ - irs_)  < spa_thresh_)) ?
 		1 : segs_per_ack_;
+	// GRO: wait for gro_segs_ segments or the delack timer
+	if (gro_interval_ > 0.0)
+		return ((rcv_nxt_ - last_ack_sent_) >= max(gro_segs_, 1) * maxseg_);
 	//Shuang
 		return ((rcv_nxt_ - last_ack_sent_) > 0);
 	//return ((rcv_nxt_ - last_ack_sent_) >= spa * maxseg_);
 
 }
 
+/*
+ * Arm the delayed ACK timer for in-order data. With GRO, the timer is
+ * not pushed back by later arrivals, so back-to-back segments within
+ * gro_interval_ of the first unacked one share one ACK. A CE transition
+ * still sends an ACK right away, so each ACK covers bytes of one CE
+ * state and DCTCP counts marked bytes as before.
+ */
+void
+FullTcpAgent::delack_arm()
+{
+	if (gro_interval_ <= 0.0)
+		delack_set(delack_interval_);
+	else if (delack_deadline_ < 0.0)
+		delack_set(gro_interval_);
+}
+
 /*
  * determine whether enough time has elapsed in order to
  * conclude a "restart" is necessary (e.g. a slow-start)
@@ -1736,6 +2959,7 @@ FullTcpAgent::recv(Packet *pkt, Handler*)
 	int ourfinisacked = FALSE;
 	int dupseg = FALSE;			// recv'd dup data segment
 	int todrop = 0;				// duplicate DATA cnt in seg
+	int granted = FALSE;			// ACK moved the Homa grant
 
 	last_state_ = state_;
 
@@ -1811,12 +3035,56 @@ FullTcpAgent::recv(Packet *pkt, Handler*)
 	if (ecnhat_)
 		update_ecnhat_alpha(pkt);
 
+	/* AccECN: count every ECN capable byte that arrives, and the marked ones */
+	if (accecn_ && datalen > 0 && fh->ect()) {
+		ace_ect_rcvd_ += datalen;
+		if (fh->ce())
+			ace_ce_rcvd_ += datalen;
+	}
+
+	/* INT: keep the records of data to echo them, react to echoed ones */
+	if (tcph->int_on() && datalen > 0)
+		int_save(tcph);
+	else if (cc_mode_ == CC_HPCC && tcph->int_nhop() > 0)
+		hpcc_ack(tcph);
+
+	/* DCQCN: CE marked data makes a CNP, a CNP cuts the rate */
+	if (cc_mode_ == CC_DCQCN) {
+		if (datalen > 0 && fh->ce() && fh->ect())
+			dcqcn_ce();
+		if (tcph->cnp())
+			dcqcn_cnp();
+	}
+
+	/* Homa: data is reported to the grant controller, ACKs carry grants */
+	if (cc_mode_ == CC_HOMA && state_ >= TCPS_ESTABLISHED) {
+		if (datalen > 0)
+			homa_data(tcph, datalen);
+		granted = homa_ack(tcph);
+	}
+
 	/* Mohammad: check if we need to inform
 	 * pacer of ecnecho.
 	 */
 	if (!(tiflags & TH_SYN) && fh->ecnecho())
 	        informpacer = 1;
 
+	/*
+	 * Packet trimming: a switch cut the payload of this segment.
+	 * NACK it so that the sender retransmits it right away.
+	 */
+	if (tcph->trimmed()) {
+		if (TCPS_HAVERCVDSYN(state_) && tcph->seqno() >= rcv_nxt_)
+			send_nack(tcph->seqno());
+		goto drop;
+	}
+
+	/* the peer got the header of a trimmed segment */
+	if ((tiflags & TH_NACK) && datalen == 0) {
+		trim_rexmit(tcph->nackno());
+		goto drop;
+	}
+
 	/*if (datalen > 0)
 	  printf("received data: datalen = %d seqno = %d, ackno = %d, ce = %d, ecn-echo = %d\n", datalen, tcph->seqno(), ackno, fh->ce(), fh->ecnecho());
 	else
@@ -1850,7 +3118,12 @@ FullTcpAgent::recv(Packet *pkt, Handler*)
 		//
 
 	    	if (ecn_) {
-		  if (ecnhat_) { // Mohammad
+		  if (accecn_) {
+			// AccECN: ECE tells that marks arrived since the last ACK
+			if (fh->ce() && fh->ect())
+				recent_ce_ = TRUE;
+			ce_transition_ = 0;
+		  } else if (ecnhat_) { // Mohammad
 	    		if (fh->ce() && fh->ect()) {
 	    			// no CWR from peer yet... arrange to
 	    			// keep sending ECNECHO
@@ -1897,7 +3170,7 @@ FullTcpAgent::recv(Packet *pkt, Handler*)
 			    cwnd_ >= wnd_ && !fastrecov_) {
 				newack(pkt);	// update timers,  highest_ack_
 				send_much(0, REASON_NORMAL, maxburst_);
-				Packet::free(pkt);
+				pool_free(pkt);
 				return;
 			}
 		} else if (ackno == highest_ack_ && rq_.empty()) {
@@ -1927,7 +3200,7 @@ FullTcpAgent::recv(Packet *pkt, Handler*)
 
 			flags_ |= TF_DELACK;
 			// Mohammad
-			delack_timer_.resched(delack_interval_);
+			delack_arm();
 
 			// printf("%f: receving data %d, rescheduling delayed ack\n", Scheduler::instance().clock(), rcv_nxt_);
 
@@ -1947,7 +3220,7 @@ FullTcpAgent::recv(Packet *pkt, Handler*)
 			// special code here to simulate the operation
 			// of a receiver who always consumes data,
 			// resulting in a call to tcp_output
-			Packet::free(pkt);
+			pool_free(pkt);
 			if (need_send()){
 				send_much(1, REASON_NORMAL, maxburst_);
 //				if(fid_==2352) printf("before2 need_send fid= %d, rcv_nxt_= %d highest_ack= %d, last_ack_sent= %d\n",fid_,(int)rcv_nxt_,(int)highest_ack_,last_ack_sent_);
@@ -2101,6 +3374,8 @@ cancel_rtx_timer();	// cancel timer on our 1st SYN [does this belong!?]
 	    		}
 			highest_ack_ = ackno;
 			cwnd_ = initial_window();
+			if (rtt_active_ && rtt_seq_ == iss_)
+				syn_rtt_ = now() - rtt_ts_;	// paces the initial window
 
 #ifdef notdef
 /*
@@ -2120,7 +3395,7 @@ if (t_rtt_) {
 			if (datalen > 0) {
 				flags_ |= TF_DELACK;	// data there: wait
 				// Mohammad
-				delack_timer_.resched(delack_interval_);
+				delack_set(delack_interval_);
 			} else {
 				flags_ |= TF_ACKNOW;	// ACK peer's SYN
 			}
@@ -2294,6 +3569,8 @@ trimthenstep6:
 		 * Trim duplicate data from the front of the packet
 		 */
 
+		if (todrop > 0)
+			dsack_note(tcph->seqno(), tcph->seqno() + todrop);
 		tcph->seqno() += todrop;
 		th->size() -= todrop;	// XXX Must decrease size too!!
 					// why? [kf]..prob when put in RQ
@@ -2437,7 +3714,11 @@ trimthenstep6:
 		//
 
 	    	if (ecn_) {
-		  if (ecnhat_) { // Mohammad
+		  if (accecn_) {
+			if (fh->ce() && fh->ect())
+				recent_ce_ = TRUE;
+			ce_transition_ = 0;
+		  } else if (ecnhat_) { // Mohammad
 		    	if (fh->ce() && fh->ect()) {
 	    			// no CWR from peer yet... arrange to
 	    			// keep sending ECNECHO
@@ -2523,19 +3804,25 @@ trimthenstep6:
                                  * network.
                                  */
 
-				if ((rtx_timer_.status() != TIMER_PENDING) ||
+				if (granted) {
+					// a new grant, not a duplicate
+					send_much(0, REASON_NORMAL, maxburst_);
+					goto drop;
+				} else if (!rtx_pending() ||
 				    ackno < highest_ack_) {
 					// Q: significance of timer not pending?
 					// ACK below highest_ack_
 					oldack();
-				} else if (++dupacks_ == tcprexmtthresh_) {
-					// ACK at highest_ack_ AND meets threshold
+				} else if (++dupacks_ == rexmt_thresh() || rack_detect()) {
+					// ACK at highest_ack_ AND meets threshold,
+					// or RACK found the first unacked seg lost
 					//trace_event("FAST_RECOVERY");
 					//Shuang: dupack_action
+					dupacks_ = rexmt_thresh();
 					dupack_action(); // maybe fast rexmt
 					goto drop;
 
-				} else if (dupacks_ > tcprexmtthresh_) {
+				} else if (dupacks_ > rexmt_thresh()) {
 					// ACK at highest_ack_ AND above threshole
 					//trace_event("FAST_RECOVERY");
 					extra_ack();
@@ -2587,7 +3874,12 @@ process_ACK:
                  * If there is more data to be acked, restart retransmit
                  * timer, using current (possibly backed-off) value.
                  */
+		int acked = ackno - highest_ack_;
 		newack(pkt);	// handle timers, update highest_ack_
+		if (cc_mode_ == CC_SWIFT && last_state_ == TCPS_ESTABLISHED)
+			swift_ack(tcph, acked);
+		else if (cc_mode_ == CC_BBR && last_state_ == TCPS_ESTABLISHED)
+			bbr_ack(ackno, acked);
 
 		/*
 		 * if this is a partial ACK, invoke whatever we should
@@ -2607,7 +3899,7 @@ process_ACK:
 		 * if this is an ACK with an ECN indication, handle this
 		 * but not if it is a syn packet
 		 */
-		if (fh->ecnecho() && !(tiflags&TH_SYN) )
+		if (fh->ecnecho() && !(tiflags&TH_SYN) && cc_mode_ == CC_DEFAULT)
 		  if (fh->ecnecho()) {
 			// Note from Sally: In one-way TCP,
 			// ecn() is called before newack()...
@@ -2648,7 +3940,7 @@ process_ACK:
                  * (maxseg^2 / cwnd per packet).
                  */
 		if ((!delay_growth_ || (rcv_nxt_ > 0)) &&
-		    last_state_ == TCPS_ESTABLISHED) {
+		    last_state_ == TCPS_ESTABLISHED && cc_mode_ == CC_DEFAULT) {
 			if (!partial || open_cwnd_on_pack_) {
 				if (!ect_ || !hdr_flags::access(pkt)->ecnecho() || ecn_burst_)
 				  opencwnd();
@@ -2770,7 +4062,7 @@ step6:
 
 		        flags_ |= TF_DELACK;
 			// Mohammad
-			delack_timer_.resched(delack_interval_);
+			delack_arm();
 			rcv_nxt_ += datalen;
 
 			// printf("%f: receving data %d, rescheduling delayed ack\n", Scheduler::instance().clock(), rcv_nxt_);
@@ -2896,7 +4188,7 @@ step6:
 	if (!halfclose_ && state_ == TCPS_CLOSE_WAIT && highest_ack_ == maxseq_)
 		usrclosed();
 
-	Packet::free(pkt);
+	pool_free(pkt);
 
 	// haoboy: Is here the place for done{} of active close?
 	// It cannot be put in the switch above because we might need to do
@@ -2926,7 +4218,7 @@ dropwithreset:
 		sendpacket(0, ack, TH_ACK, 0, REASON_NORMAL);
 	}
 drop:
-   	Packet::free(pkt);
+   	pool_free(pkt);
 	return;
 }
 
@@ -3061,9 +4353,20 @@ FullTcpAgent::timeout(int tno)
 	switch (tno) {
 
 	case TCP_TIMER_RTX:
+		/* a lazy timer may fire before its deadline, or after a cancel */
+		if (rtx_deadline_ < 0.0)
+			break;
+		if (now() < rtx_deadline_) {
+			rtx_timer_.resched(rtx_deadline_ - now());
+			rtx_sched_ = rtx_deadline_;
+			break;
+		}
+		rtx_deadline_ = -1.0;
                 /* retransmit timer */
                 ++nrexmit_;
                 timeout_action();
+		if (cc_mode_ == CC_SWIFT)
+			swift_loss();
 		/* fall thru */
 	case TCP_TIMER_DELSND:
 		/* for phase effects */
@@ -3071,6 +4374,14 @@ FullTcpAgent::timeout(int tno)
 		break;
 
 	case TCP_TIMER_DELACK:
+		if (delack_deadline_ < 0.0)
+			break;
+		if (now() < delack_deadline_) {
+			delack_timer_.resched(delack_deadline_ - now());
+			delack_sched_ = delack_deadline_;
+			break;
+		}
+		delack_deadline_ = -1.0;
                 if (flags_ & TF_DELACK) {
                         flags_ &= ~TF_DELACK;
                         flags_ |= TF_ACKNOW;
@@ -3079,6 +4390,14 @@ FullTcpAgent::timeout(int tno)
 		// Mohammad
                 //delack_timer_.resched(delack_interval_);
 		break;
+
+	case TCP_TIMER_PACE:
+		send_much(0, REASON_NORMAL, maxburst_);
+		break;
+	case TCP_TIMER_DCQCN_ALPHA:
+	case TCP_TIMER_DCQCN_RATE:
+		dcqcn_timeout(tno);
+		break;
 	default:
 		fprintf(stderr, "%f: FullTcpAgent(%s) Unknown Timeout type %d\n",
 			now(), name(), tno);
@@ -3299,6 +4618,13 @@ SackFullTcpAgent::reset()
 	sq_.clear();			// no SACK blocks
 	/* Fixed typo.  -M. Weigle 6/17/02 */
 	sack_min_ = h_seqno_ = -1;	// no left edge of SACK blocks
+	h_scan_ = -1;
+	tlp_high_ = -1;
+	stq_.clear();
+	rack_xmit_ts_ = -1.0;
+	rack_end_ = -1;
+	rack_rtt_ = 0.0;
+	rack_reo_mult_ = 1;
 	FullTcpAgent::reset();
 }
 
@@ -3347,6 +4673,7 @@ SackFullTcpAgent::dupack_action()
 		int amt = fast_retransmit(highest_ack_);
 		pipectrl_ = TRUE;
 		h_seqno_ = highest_ack_ + amt;
+		h_scan_ = -1;
 		send_much(0, REASON_DUPACK, maxburst_);
 		return;
 	}
@@ -3375,6 +4702,7 @@ full_sack_action:
 
 	int amt = fast_retransmit(highest_ack_);
 	h_seqno_ = highest_ack_ + amt;
+	h_scan_ = -1;
 
 //printf("%f: FAST-RTX seq:%d, h_seqno_ is now:%d, pipe:%d, cwnd:%d, recover:%d\n",
 //now(), int(highest_ack_), h_seqno_, pipe_, int(cwnd_), recover_);
@@ -3394,6 +4722,9 @@ SackFullTcpAgent::pack_action(Packet* p)
 	pipe_ -= maxseg_;	// see comment in tcp-sack1.cc
 	if (h_seqno_ < highest_ack_)
 		h_seqno_ = highest_ack_;
+	if (rack_)
+		rack_update(highest_ack_ - 1);
+	stq_.clearto(highest_ack_);
 }
 
 void
@@ -3417,6 +4748,12 @@ SackFullTcpAgent::ack_action(Packet* p)
 	 */
 	if (h_seqno_ < highest_ack_)
 		h_seqno_ = highest_ack_;
+
+	if (rack_)
+		rack_update(highest_ack_ - 1);
+	stq_.clearto(highest_ack_);
+	if (tlp_high_ >= 0 && highest_ack_ >= tlp_high_)
+		tlp_high_ = -1;	// the probe is acked
 }
 
 //
@@ -3428,13 +4765,22 @@ SackFullTcpAgent::build_options(hdr_tcp* tcph)
 {
 	int total = FullTcpAgent::build_options(tcph);
 
-        if (!rq_.empty()) {
-                int nblk = rq_.gensack(&tcph->sa_left(0), max_sack_blocks_);
-                tcph->sa_length() = nblk;
+	int maxblk = (max_sack_blocks_ > MAX_NSA) ? MAX_NSA : max_sack_blocks_;
+	int nblk = 0;
+
+	/* a DSACK block goes first and is sent once (RFC 2883) */
+	if (dsack_ && dsack_right_ > dsack_left_ && maxblk > 0) {
+		tcph->sa_left(0) = dsack_left_;
+		tcph->sa_right(0) = dsack_right_;
+		nblk = 1;
+	}
+	dsack_left_ = dsack_right_ = -1;
+
+        if (!rq_.empty())
+                nblk += rq_.gensack(&tcph->sa_left(nblk), maxblk - nblk);
+        tcph->sa_length() = nblk;
+        if (nblk > 0)
 		total += (nblk * sack_block_size_) + sack_option_size_;
-        } else {
-                tcph->sa_length() = 0;
-        }
 	//Shuang: reduce ack size
 	//return 0;
 	return (total);
@@ -3475,6 +4821,8 @@ SackFullTcpAgent::timeout_action()
 		sq_.clear();
 		sack_min_ = highest_ack_;
 	}
+	h_scan_ = -1;
+	tlp_high_ = -1;
 
 	return;
 }
@@ -3496,8 +4844,28 @@ SackFullTcpAgent::process_sack(hdr_tcp* tcph)
 		return;
 	}
 
-	int slen = tcph->sa_length(), i;
-	for (i = 0; i < slen; ++i) {
+	int slen = tcph->sa_length(), i = 0, first = 0;
+
+	/*
+	 * A first block below the ACK, or inside the second block, is a
+	 * DSACK: a segment arrived twice, so our retransmission of it was
+	 * spurious and the path reorders. Wait for one more dupack before
+	 * the next fast retransmit, up to a window.
+	 */
+	if (slen > 0 && (tcph->sa_right(0) <= tcph->ackno() ||
+	    (slen > 1 && tcph->sa_left(0) >= tcph->sa_left(1) &&
+	     tcph->sa_right(0) <= tcph->sa_right(1)))) {
+		ndsack_++;
+		if (dsack_reorder_ && rexmt_thresh() < window())
+			reorder_thresh_ = rexmt_thresh() + 1;
+		if (dsack_reorder_)
+			rack_reo_mult_++;
+		if (tcph->sa_right(0) <= tcph->ackno())
+			i = 1;	// nothing new to the scoreboard
+		first = 1;
+	}
+
+	for (; i < slen; ++i) {
 		/* Added check for FIN   -M. Weigle 5/21/02 */
 		if ((tcph->flags() & TH_FIN == 0) &&
 		    tcph->sa_left(i) >= tcph->sa_right(i)) {
@@ -3509,10 +4877,185 @@ SackFullTcpAgent::process_sack(hdr_tcp* tcph)
 		sq_.add(tcph->sa_left(i), tcph->sa_right(i), 0);
 	}
 
+	/* the receiver reports the block of its latest arrival first */
+	if (rack_ && first < slen)
+		rack_update(tcph->sa_right(first) - 1);
+
 	cur_sqtotal_ = sq_.total();
 	return;
 }
 
+void
+SackFullTcpAgent::timeout(int tno)
+{
+	switch (tno) {
+
+	case TCP_TIMER_TLP:
+		if (tlp_deadline_ < 0.0)
+			break;
+		if (now() < tlp_deadline_) {
+			tlp_timer_.resched(tlp_deadline_ - now());
+			tlp_sched_ = tlp_deadline_;
+			break;
+		}
+		tlp_deadline_ = -1.0;
+		tlp_probe();
+		break;
+
+	case TCP_TIMER_RACK:
+		if (state_ >= TCPS_ESTABLISHED && rtx_pending() && rack_detect()) {
+			dupacks_ = rexmt_thresh();
+			dupack_action();
+		}
+		break;
+
+	default:
+		FullTcpAgent::timeout(tno);
+	}
+}
+
+void
+SackFullTcpAgent::cancel_timers()
+{
+	FullTcpAgent::cancel_timers();
+	tlp_timer_.force_cancel();
+	tlp_deadline_ = -1.0;
+	rack_timer_.force_cancel();
+}
+
+void
+SackFullTcpAgent::cancel_rtx_timer()
+{
+	FullTcpAgent::cancel_rtx_timer();
+	tlp_deadline_ = -1.0;
+	if (!lazy_timers_)
+		tlp_timer_.force_cancel();
+}
+
+/*
+ * Schedule a probe 2*srtt after the latest transmission, plus the
+ * delayed ACK time if a single segment is outstanding, unless the RTO
+ * comes first. There is
+ * no probe during recovery or while an earlier probe is unacked.
+ */
+void
+SackFullTcpAgent::tlp_arm()
+{
+	double pto = 2 * rtt_srtt();
+
+	tlp_deadline_ = -1.0;
+	if (!tlp_ || pto <= 0.0 || fastrecov_ || highest_ack_ < recover_ ||
+	    tlp_high_ >= 0 || state_ < TCPS_ESTABLISHED)
+		return;
+	if (maxseq_ - highest_ack_ <= maxseg_)
+		pto += delack_interval_;
+	if (now() + pto >= rtx_deadline_)
+		return;
+
+	tlp_deadline_ = now() + pto;
+	if (!lazy_timers_ || tlp_timer_.status() != TIMER_PENDING ||
+	    tlp_sched_ > tlp_deadline_) {
+		tlp_timer_.resched(pto);
+		tlp_sched_ = tlp_deadline_;
+	}
+}
+
+/*
+ * Send the last segment again. Any new data the window allows has
+ * already gone out in send_much(), so the probe is a retransmission.
+ * Its ACK carries a SACK of the tail, from which RACK or the dupack
+ * threshold starts fast recovery.
+ */
+void
+SackFullTcpAgent::tlp_probe()
+{
+	int seq = maxseq_ - maxseg_;
+
+	if (fastrecov_ || highest_ack_ < recover_ || highest_ack_ >= maxseq_ ||
+	    !rtx_pending() || state_ < TCPS_ESTABLISHED)
+		return;
+	if (seq < highest_ack_)
+		seq = highest_ack_;
+	if (foutput(seq, REASON_TLP) <= 0)
+		return;
+	++ntlp_;
+	tlp_high_ = maxseq_;
+	tlp_deadline_ = -1.0;	// armed by the probe itself, one at a time
+	set_rtx_timer();	// the RTO runs from the probe
+}
+
+/* data went out: note its send time and restart the probe time from now */
+void
+SackFullTcpAgent::tx_stamp(int seq, int len)
+{
+	if (rack_)
+		stq_.sent(seq, len, maxseg_, now());
+	tlp_arm();
+}
+
+void
+SackFullTcpAgent::rack_update(int seq)
+{
+	double ts = 0.0;
+	int end = 0, rexmit = 0;
+
+	if (!stq_.lookup(seq, ts, end, rexmit))
+		return;
+	/* ACKed sooner than the min RTT: the original, not the rexmit, arrived */
+	if (rexmit && now() - ts < rtt_min())
+		return;
+	if (ts > rack_xmit_ts_ || (ts == rack_xmit_ts_ && end > rack_end_)) {
+		rack_xmit_ts_ = ts;
+		rack_end_ = end;
+		rack_rtt_ = now() - ts;
+	}
+}
+
+/* a quarter of the min RTT per DSACK round, at most srtt */
+double
+SackFullTcpAgent::rack_reo_wnd()
+{
+	double wnd = rack_reo_mult_ * rtt_min() / 4;
+
+	return (wnd < rtt_srtt() ? wnd : rtt_srtt());
+}
+
+/*
+ * Called on a dupack below the dupack threshold. Look at the unacked,
+ * unSACKed segments up to the latest delivered one. A segment sent before
+ * it is lost once an RTT plus the reordering window has passed since it
+ * was sent. If none is lost yet but some would be, the RACK timer looks
+ * again at the earliest such time. Return TRUE if fast retransmit should
+ * start.
+ */
+int
+SackFullTcpAgent::rack_detect()
+{
+	double ts = 0.0, wait = 0.0, next = -1.0;
+	int seq = highest_ack_, end = 0, rexmit = 0;
+
+	if (!rack_ || fastrecov_ || dupacks_ >= rexmt_thresh() || rack_xmit_ts_ < 0.0)
+		return (FALSE);
+
+	for (; seq < rack_end_ && stq_.lookup(seq, ts, end, rexmit); seq = end) {
+		if (sq_.contains(seq, end))
+			continue;
+		/* only a segment sent before a delivered one can be lost */
+		if (ts > rack_xmit_ts_ || (ts == rack_xmit_ts_ && end >= rack_end_))
+			continue;
+		wait = ts + rack_rtt_ + rack_reo_wnd() - now();
+		if (wait <= 0.0) {
+			++nrack_;
+			return (TRUE);
+		}
+		if (next < 0.0 || wait < next)
+			next = wait;
+	}
+	if (next > 0.0)
+		rack_timer_.resched(next);
+	return (FALSE);
+}
+
 int
 SackFullTcpAgent::send_allowed(int seq)
 {
@@ -3532,6 +5075,8 @@ SackFullTcpAgent::send_allowed(int seq)
 	if (seq >= topawin) {
 		return FALSE;
 	}
+	if (cc_mode_ == CC_HOMA && !homa_allowed(seq))
+		return FALSE;
 
 	/*
 	 * If not in ESTABLISHED, don't send anything we don't have
@@ -3578,6 +5123,16 @@ SackFullTcpAgent::nxt_tseq()
 //now(), int(t_seqno_), seq, sack_rtx_threshmode_);
 //sq_.dumplist();
 
+	/*
+	 * Resume after the holes skipped by earlier calls, unless
+	 * a SACK has since changed a block among them, so that each
+	 * hole is looked at once per change rather than once per ACK.
+	 */
+	if (sq_.lowchange() < h_scan_)
+		h_scan_ = -1;
+	if (h_scan_ > seq)
+		seq = h_scan_;
+
 	while ((seq = sq_.nexthole(seq, fcnt, fbytes)) > 0) {
 		// if we have a following block
 		// with a large enough count
@@ -3606,6 +5161,7 @@ SackFullTcpAgent::nxt_tseq()
 				seq ++;
 			} else
 			seq += maxseg_;
+			h_scan_ = seq;
 		}
 	}
 //if (int(t_seqno_) > 1)
@@ -3628,6 +5184,7 @@ MinTcpAgent::timeout_action() {
 		}
 		//Shuang: h_seqno_?
 		h_seqno_ = highest_ack_;
+		h_scan_ = -1;
 	}
 
 
@@ -3671,7 +5228,7 @@ DDTcpAgent::slowdown(int how) {
 		if (tleft < 0) {
 			tleft = 1e10;
 		}
-		double rtt = int(t_srtt_ >> T_SRTT_BITS) * tcp_tick_;
+		double rtt = rtt_srtt();
 		double Tc = byterm() / (0.75 * cwnd_ * maxseg_) * rtt;
 		double d = Tc/tleft;
 		if (d > 2) d = 2;
@@ -4,6 +4,11 @@
 
 #include "tcp.h"
 #include "rq.h"
+#include "interval-rq.h"
+#include "send-time-q.h"
+
+class PiasController;
+class HomaGrantController;
 
 /*
  * most of these defines are directly from
@@ -43,6 +48,12 @@
 
 #define	TCP_NSTATES		10	/* total number of states */
 
+#define TCP_TIMER_PACE		6	/* FullTcp pacing timer */
+#define TCP_TIMER_TLP		7	/* SackFullTcp tail loss probe */
+#define TCP_TIMER_RACK		8	/* SackFullTcp RACK reordering timer */
+#define TCP_TIMER_DCQCN_ALPHA	9	/* FullTcp DCQCN alpha update */
+#define TCP_TIMER_DCQCN_RATE	10	/* FullTcp DCQCN rate increase */
+
 #define TCPS_HAVERCVDFIN(s) ((s) == TCPS_CLOSING || (s) == TCPS_CLOSED || (s) == TCPS_CLOSE_WAIT)
 #define	TCPS_HAVERCVDSYN(s) ((s) >= TCPS_SYN_RECEIVED)
 
@@ -53,6 +64,8 @@
 #define REASON_DUPACK   2
 #define	REASON_RBP	3	/* if ever implemented */
 #define	REASON_SACK	4	/* hole fills in SACK */
+#define	REASON_TRIM	5	/* NACK of a trimmed segment */
+#define	REASON_TLP	6	/* tail loss probe */
 
 /* bits for the tcp_flags field below */
 /* from tcp.h in the "real" implementation */
@@ -64,11 +77,41 @@
 #define TH_ACK  0x10        /* ACK: ack number is valid */
 #define TH_ECE  0x40        /* ECE: CE echo flag */
 #define TH_CWR  0x80        /* CWR: congestion window reduced */
+#define TH_NACK 0x100       /* NACK: nackno is a trimmed segment (simulator-specific) */
 
 
 #define PF_TIMEOUT 0x04	    /* protocol defined */
 #define	TCP_PAWS_IDLE	(24 * 24 * 60 * 60)	/* 24 days in secs */
 
+#define MAX_PIAS_PRIO_NUM	16	/* PIAS priorities (demotion levels) */
+#define MAX_PIAS_SERVICE_NUM	64	/* services with their own PIAS thresholds */
+#define MAX_PENDING_MSG		64	/* unacked messages on a connection */
+#define MAX_PKT_POOL_SIZE	64	/* received packets kept for reuse */
+#define MAX_TSO_SEGS		64	/* MSS in a TSO super-segment */
+
+/* congestion control of FullTcpAgent (cc_mode_) */
+#define CC_DEFAULT	0	/* slow start and AIMD, with ECN/DCTCP as configured */
+#define CC_HPCC		1	/* window from INT link utilization (HPCC) */
+#define CC_SWIFT	2	/* delay based AIMD (Swift) */
+#define CC_BBR		3	/* bandwidth and min RTT model (BBR) */
+#define CC_DCQCN	4	/* rate based, cut by CNPs from the receiver (DCQCN) */
+#define CC_HOMA		5	/* receiver granted, by remaining message size (Homa) */
+
+/* BBR states */
+#define BBR_STARTUP	0
+#define BBR_DRAIN	1
+#define BBR_PROBE_BW	2
+#define BBR_PROBE_RTT	3
+#define BBR_CYCLE_LEN	8	/* phases of the PROBE_BW gain cycle */
+#define MAX_BBR_BW_ROUNDS	32	/* rounds in the max bandwidth filter */
+
+/* a message sent by advance_msg, its bytes are (start, end] */
+struct PendingMsg {
+	int id;
+	int start;
+	int end;
+};
+
 class FullTcpAgent;
 class DelAckTimer : public TimerHandler {
 public:
@@ -78,30 +121,144 @@ protected:
 	FullTcpAgent *a_;
 };
 
+class PaceTimer : public TimerHandler {
+public:
+	PaceTimer(FullTcpAgent *a) : TimerHandler(), a_(a) { }
+protected:
+	virtual void expire(Event *);
+	FullTcpAgent *a_;
+};
+
+class DcqcnAlphaTimer : public TimerHandler {
+public:
+	DcqcnAlphaTimer(FullTcpAgent *a) : TimerHandler(), a_(a) { }
+protected:
+	virtual void expire(Event *);
+	FullTcpAgent *a_;
+};
+
+class DcqcnRateTimer : public TimerHandler {
+public:
+	DcqcnRateTimer(FullTcpAgent *a) : TimerHandler(), a_(a) { }
+protected:
+	virtual void expire(Event *);
+	FullTcpAgent *a_;
+};
+
+class TlpTimer : public TimerHandler {
+public:
+	TlpTimer(FullTcpAgent *a) : TimerHandler(), a_(a) { }
+protected:
+	virtual void expire(Event *);
+	FullTcpAgent *a_;
+};
+
+class RackTimer : public TimerHandler {
+public:
+	RackTimer(FullTcpAgent *a) : TimerHandler(), a_(a) { }
+protected:
+	virtual void expire(Event *);
+	FullTcpAgent *a_;
+};
+
 class FullTcpAgent : public TcpAgent {
 public:
 	FullTcpAgent() :
 		prio_scheme_(0), prio_num_(0), startseq_(0), last_prio_(0), seq_bound_(0),
 		closed_(0), pipe_(-1), rtxbytes_(0), fastrecov_(FALSE),
         	last_send_time_(-1.0), infinite_send_(FALSE), irs_(-1),
-        	delack_timer_(this), flags_(0),
+        	delack_timer_(this), pace_timer_(this),
+		dcqcn_alpha_timer_(this), dcqcn_rate_timer_(this), flags_(0),
         	state_(TCPS_CLOSED), recent_ce_(FALSE),
 		  last_state_(TCPS_CLOSED), rq_(rcv_nxt_), last_ack_sent_(-1),
 		  informpacer(0), enable_pias_(0), pias_prio_num_(0), pias_debug_(0),
-		  bytes_(0),serviceid_(0) { }
+		  bytes_(0),serviceid_(0), ntrimrexmit_(0) {
+			for (int i = 0; i < MAX_PIAS_PRIO_NUM - 1; i++)
+				pias_thresh_[i] = 0;
+			pias_ctrl_ = NULL;
+			pias_snap_num_ = 0;
+			pias_invalidate();
+			msg_head_ = msg_num_ = msg_cur_ = 0;
+			msg_id_ = -1;
+			pkt_tmpl_ = NULL;
+			pkt_pool_num_ = 0;
+			pkt_pool_size_ = 0;
+			dsack_left_ = dsack_right_ = -1;
+			reorder_thresh_ = 0;
+			tso_segs_ = 1;
+			gro_interval_ = 0.0;
+			gro_segs_ = 1;
+			lazy_timers_ = 0;
+			rtx_deadline_ = rtx_sched_ = -1.0;
+			delack_deadline_ = delack_sched_ = -1.0;
+			pace_gain_ = 0.0;
+			pace_burst_ = 2;
+			pace_credit_ = 0;
+			pace_next_ = 0.0;
+			syn_rtt_ = -1.0;
+			cc_mode_ = CC_DEFAULT;
+			int_echo_num_ = 0;
+			hpcc_nhop_ = 0;
+			hpcc_u_ = hpcc_wc_ = hpcc_w_ = 0.0;
+			hpcc_stage_ = 0;
+			hpcc_update_seq_ = -1;
+			hpcc_eta_ = 0.95;
+			hpcc_max_stage_ = 5;
+			hpcc_wai_ = 80;
+			hpcc_base_rtt_ = 0.0;
+			swift_fcwnd_ = swift_ecwnd_ = swift_cwnd_ = 0.0;
+			swift_last_decrease_ = -1.0;
+			swift_ai_ = 1.0;
+			swift_beta_ = 0.8;
+			swift_max_mdf_ = 0.5;
+			swift_base_target_ = 0.000015;
+			swift_hop_scale_ = 0.000002;
+			swift_fs_range_ = 0.00005;
+			swift_fs_min_cwnd_ = 0.1;
+			swift_fs_max_cwnd_ = 100;
+			swift_host_target_ = 0.0;
+			swift_min_cwnd_ = 0.001;
+			swift_hops_ = 0;
+			bbr_high_gain_ = 2.885;
+			bbr_cwnd_gain_ = 2.0;
+			bbr_bw_rounds_ = 10;
+			bbr_probe_rtt_time_ = 0.2;
+			bbr_min_cwnd_ = 4;
+			bbr_init();
+			dcqcn_line_rate_ = 10e9;
+			dcqcn_min_rate_ = 10e6;
+			dcqcn_g_ = 1.0 / 256;
+			dcqcn_alpha_interval_ = 0.000055;
+			dcqcn_rate_interval_ = 0.0003;
+			dcqcn_byte_thresh_ = 10000000;
+			dcqcn_f_ = 5;
+			dcqcn_rai_ = 40e6;
+			dcqcn_rhai_ = 200e6;
+			dcqcn_cnp_interval_ = 0.00005;
+			ncnp_ = 0;
+			dcqcn_init();
+			homa_ctrl_ = NULL;
+			homa_rtt_bytes_ = 14600;
+			homa_prio_num_ = 8;
+			homa_init();
+		}
 		// Mohammad: added informpacer
 		//Wei: add enable_pias_
 
-	~FullTcpAgent() { cancel_timers(); rq_.clear(); }
+	~FullTcpAgent() { cancel_timers(); rq_.clear(); pool_clear(); }
 	virtual void recv(Packet *pkt, Handler*);
 	virtual void timeout(int tno); 	// tcp_timers() in real code
 	virtual void close() { usrclosed(); }
 	void advanceby(int);	// over-rides tcp base version
 	virtual void advance_bytes(int);	// unique to full-tcp
+	void advance_msg(int nbytes, int id);	// advance_bytes with a message boundary
         virtual void sendmsg(int nbytes, const char *flags = 0);
         virtual int& size() { return maxseg_; } //FullTcp uses maxseg_ for size_
 	virtual int command(int argc, const char*const* argv);
        	virtual void reset();       		// reset to a known point
+	int homa_grant(int rank);	// rank among granted messages, TRUE if the grant changed
+	void homa_send_grant();	// send the grant now
+	static int new_uid() { return (uidcnt_++); }	// uid of a packet not made by allocpkt()
 protected:
 	virtual void delay_bind_init_all();
 	virtual int delay_bind_dispatch(const char *varName, const char *localName, TclObject *tracer);
@@ -114,14 +271,252 @@ protected:
 	virtual int byterm();
 	/* Wei: PIAS priority */
 	virtual int piasPrio(int bytes_sent);
+	int pias_levels();	//number of PIAS priorities of this flow
+	const int* pias_thresholds(int &levels);	//PIAS thresholds of this flow
+	void pias_new_flow();	//pick up thresholds for a new message
+	void pias_update(int bytes_sent);	//recompute the cached PIAS priority
+	void pias_invalidate() { pias_lo_ = 0; pias_hi_ = -1; }
 
 	int prio_scheme_;
 	int prio_num_; //number of priorities; 0: unlimited
 	int prio_cap_[7];
     	int enable_pias_;   //wei: enable PIAS or not
-	int pias_prio_num_;	//wei: number of priorities used by PIAS (no more than 8)
-    	int pias_thresh_[7];    //wei: demotion thresholds of PIAS
+	int pias_prio_num_;	//wei: number of priorities used by PIAS (no more than MAX_PIAS_PRIO_NUM)
+    	int pias_thresh_[MAX_PIAS_PRIO_NUM - 1];    //wei: demotion thresholds of PIAS
 	int pias_debug_;	//wei: debug mode for PIAS
+	int pias_level_;	//PIAS priority of bytes sent in (pias_lo_, pias_hi_]
+	int pias_lo_;
+	int pias_hi_;
+	/* per-service PIAS thresholds shared by all agents (0 priorities: use the agent's own) */
+	static int pias_service_prio_num_[MAX_PIAS_SERVICE_NUM];
+	static int pias_service_thresh_[MAX_PIAS_SERVICE_NUM][MAX_PIAS_PRIO_NUM - 1];
+	PiasController *pias_ctrl_;	//adaptive PIAS thresholds of this host
+	/* queue + 1 of (service, PIAS level) shared by all agents (0: default) */
+	static int class_map_[MAX_PIAS_SERVICE_NUM][MAX_PIAS_PRIO_NUM];
+	int classify(int level, int def);	//queue of a data packet
+	int pias_snap_[MAX_PIAS_PRIO_NUM - 1];	//adaptive thresholds at the start of the message
+	int pias_snap_num_;	//number of priorities of pias_snap_ (0: not adaptive)
+
+	/* messages with boundaries, oldest first */
+	PendingMsg msgs_[MAX_PENDING_MSG];
+	int msg_head_;	//oldest unacked message
+	int msg_num_;	//number of unacked messages
+	int msg_cur_;	//message of the last segment sent
+	int msg_id_;	//id of the message being advanced (-1: none)
+	int msg_offset(int seqno);	//bytes of its message before seqno
+	int msg_end(int seqno);	//end of the message of seqno
+	int msg_size(int seqno);	//bytes of the message of seqno
+	void msg_acked();	//signal messages that are fully acked
+
+	/* packet pool: received packets are reused to send */
+	Packet* pool_alloc();	//allocpkt() from the pool
+	void pool_free(Packet *p);	//keep a received packet for reuse
+	void pool_clear();
+	Packet *pkt_tmpl_;	//initialized headers of this connection
+	Packet *pkt_pool_[MAX_PKT_POOL_SIZE];
+	int pkt_pool_num_;
+	int pkt_pool_size_;	//packets kept for reuse (0: no pool)
+
+	/* TSO: new data goes out in super-segments, split by a GsoSegmenter */
+	int tso_limit(int seqno);	//largest segment that may start at seqno
+	int tso_segs_;	//MSS per super-segment (1: no TSO); links and queues still see each MSS packet
+
+	/* GRO: one ACK for in-order arrivals within a time window */
+	void delack_arm();	//arm the delayed ACK timer for in-order data
+	double gro_interval_;	//coalescing window (0: no GRO)
+	int gro_segs_;	//segments that trigger an ACK before the window ends
+
+	/*
+	 * Lazy timers: setting or cancelling the rtx and delayed ACK timers
+	 * only records a deadline. The scheduled event moves only when the
+	 * deadline becomes earlier, or when the event fires before the
+	 * deadline.
+	 */
+	int lazy_timers_;
+	double rtx_deadline_;	//rtx timeout time (-1: not set)
+	double rtx_sched_;	//time of the scheduled rtx event
+	double delack_deadline_;	//delayed ACK time (-1: not set)
+	double delack_sched_;	//time of the scheduled delayed ACK event
+
+	/*
+	 * Pacing: segments leave at pace_gain_ * cwnd_ * MSS per srtt, after
+	 * a burst of pace_burst_ segments when the flow starts or restarts
+	 * from idle. Before the first RTT sample, the SYN RTT sets the rate.
+	 */
+	double pace_rtt();	//RTT for the pacing rate (-1: unknown)
+	double pace_wnd();	//bytes paced out over pace_rtt()
+	double pace_gain();	//gain in effect (0: no pacing)
+	double pace_rate();	//bytes/s (0: unknown)
+	void pace_sent(int amt);	//schedule the next segment
+	double pace_gain_;	//0: no pacing
+	int pace_burst_;
+	int pace_credit_;	//segments left in the burst
+	double pace_next_;	//time the next segment may leave
+	double syn_rtt_;	//RTT of the SYN exchange (-1: unknown)
+
+	/*
+	 * Congestion control mode. In CC_DEFAULT, cwnd_ follows opencwnd()
+	 * and ecn(); the other modes set cwnd_ themselves on each ACK and
+	 * keep only the loss reactions.
+	 */
+	int cc_mode_;
+
+	/*
+	 * HPCC: data segments collect INT records at each hop and the
+	 * receiver echoes them on its ACKs. The window is set from the
+	 * utilization of the most loaded hop against hpcc_eta_, with the
+	 * reference window hpcc_wc_ updated once per RTT. The window
+	 * may be below one segment, in which case pacing sets the rate.
+	 */
+	void int_save(hdr_tcp *tcph);	//receiver: keep INT records to echo
+	void hpcc_ack(hdr_tcp *tcph);	//sender: INT echoed on an ACK
+	int hpcc_util(hdr_tcp *tcph, double T);	//update hpcc_u_, FALSE if no sample
+	double hpcc_rtt();	//base RTT T (0: unknown)
+	IntHop int_echo_[MAX_INT_HOPS];	//INT of the last data segment received
+	int int_echo_num_;
+	IntHop hpcc_hop_[MAX_INT_HOPS];	//INT of the last ACK
+	int hpcc_nhop_;
+	double hpcc_u_;	//utilization estimate
+	double hpcc_wc_;	//reference window in bytes (0: not set)
+	double hpcc_w_;	//window in bytes (0: not set)
+	int hpcc_stage_;	//additive increases since the last multiplicative change
+	int hpcc_update_seq_;	//hpcc_wc_ is updated by the first ACK above this
+	double hpcc_eta_;	//target utilization
+	int hpcc_max_stage_;	//additive increases before a multiplicative one
+	double hpcc_wai_;	//additive increase in bytes
+	double hpcc_base_rtt_;	//T (0: min RTT)
+
+	/*
+	 * Swift: AIMD on the delay of each new ACK, separately for the
+	 * fabric delay (RTT less the receiver's ACK delay) and the
+	 * end-host delay. The fabric target grows with the hop count and
+	 * is raised for small windows (flow scaling). cwnd_ is the smaller
+	 * window, at least one segment; a window below one is paced out.
+	 * Per-ACK delay needs ts_option_.
+	 */
+	void swift_ack(hdr_tcp *tcph, int acked);	//new data acked
+	void swift_loss();	//fast retransmit or timeout
+	double swift_aimd(double w, double delay, double target, double n, int& decreased);
+	double swift_target(int hops);	//fabric target delay
+	double swift_fcwnd_;	//fabric window in segments (0: not set)
+	double swift_ecwnd_;	//end-host window in segments
+	double swift_cwnd_;	//min of the two, may be below 1
+	double swift_last_decrease_;	//time of the last decrease (-1: none)
+	double swift_ai_;	//additive increase per RTT in segments
+	double swift_beta_;	//decrease per unit of relative excess delay
+	double swift_max_mdf_;	//largest decrease in one RTT
+	double swift_base_target_;	//fabric target delay without hops
+	double swift_hop_scale_;	//fabric target delay per hop
+	double swift_fs_range_;	//flow scaling: extra target delay at fs_min_cwnd_ (0: off)
+	double swift_fs_min_cwnd_;
+	double swift_fs_max_cwnd_;	//window that gets no extra target delay
+	double swift_host_target_;	//end-host target delay (0: no end-host window)
+	double swift_min_cwnd_;
+	int swift_hops_;	//hops to the receiver when INT does not tell
+
+	/*
+	 * BBR: a delivery rate sample is taken on each new ACK from the
+	 * state saved with the segment it acks. The max of the samples over
+	 * the last bbr_bw_rounds_ rounds and the min RTT over min_rtt_win_
+	 * give the BDP; segments are paced at a gain times the bandwidth
+	 * and cwnd_ caps the flight at a gain times the BDP. PROBE_RTT
+	 * drains to bbr_min_cwnd_ when the min RTT has not been seen for
+	 * min_rtt_win_.
+	 */
+	void bbr_init();
+	void bbr_sent(int seq, int len);	//save the delivery state
+	void bbr_ack(int ackno, int acked);	//new data acked
+	void bbr_set_state(int state);
+	double bbr_max_bw();	//bytes/s (0: no sample)
+	double bbr_bdp(double gain);	//bytes (-1: no model yet)
+	double bbr_pacing_gain();
+	SendTimeQueue bbr_txq_;	//delivery state of unacked segments
+	int bbr_state_;
+	int bbr_delivered_;	//bytes delivered so far
+	double bbr_delivered_ts_;	//time bbr_delivered_ last grew
+	double bbr_first_ts_;	//send time of the last acked segment
+	int bbr_app_limited_;	//app limited until delivered passes this (0: not)
+	double bbr_bw_[MAX_BBR_BW_ROUNDS];	//max rate in each recent round
+	int bbr_round_;	//round trips so far
+	int bbr_next_round_delivered_;	//a round ends when this is acked
+	double bbr_full_bw_;	//STARTUP: bandwidth before the last plateau
+	int bbr_full_bw_cnt_;	//rounds without 25% growth
+	int bbr_filled_pipe_;
+	double bbr_min_rtt_;	//-1: no sample
+	double bbr_min_rtt_ts_;
+	int bbr_cycle_idx_;	//PROBE_BW gain phase
+	double bbr_cycle_ts_;
+	double bbr_probe_rtt_done_;	//-1: PROBE_RTT waits for the flight to drain
+	int bbr_probe_rtt_round_done_;
+	double bbr_prior_cwnd_;	//cwnd_ to restore after PROBE_RTT
+	double bbr_high_gain_;	//STARTUP pacing and cwnd gain
+	double bbr_cwnd_gain_;	//PROBE_BW cwnd gain
+	int bbr_bw_rounds_;
+	double bbr_probe_rtt_time_;
+	int bbr_min_cwnd_;	//segments
+
+	/*
+	 * DCQCN: the sender paces at dcqcn_rc_ and the window is only
+	 * the receiver's. A receiver sends a CNP, an immediate ACK with
+	 * cnp() set, for CE marked data at most once per
+	 * dcqcn_cnp_interval_. A CNP cuts the rate by alpha / 2; the rate
+	 * recovers toward dcqcn_rt_ each dcqcn_rate_interval_ and each
+	 * dcqcn_byte_thresh_ bytes sent, then increases additively and,
+	 * after dcqcn_f_ steps of both, hyper additively.
+	 */
+	virtual int window();
+	void dcqcn_init();
+	void dcqcn_ce();	//receiver: CE marked data arrived
+	void dcqcn_cnp();	//sender: CNP arrived
+	void dcqcn_sent(int len);
+	void dcqcn_increase();
+	void dcqcn_timeout(int tno);
+	double dcqcn_rc_;	//current rate, bits/s
+	double dcqcn_rt_;	//target rate
+	double dcqcn_alpha_;
+	int dcqcn_cnp_seen_;	//CNP since the last alpha update?
+	int dcqcn_bytes_;	//sent since the last byte counter step
+	int dcqcn_t_cnt_;	//timer steps since the last CNP
+	int dcqcn_b_cnt_;	//byte counter steps since the last CNP
+	int dcqcn_cnp_send_;	//receiver: set cnp() on the next ACK
+	double dcqcn_cnp_last_;	//receiver: time of the last CNP (-1: none)
+	double dcqcn_line_rate_;	//initial and largest rate
+	double dcqcn_min_rate_;
+	double dcqcn_g_;	//alpha gain
+	double dcqcn_alpha_interval_;
+	double dcqcn_rate_interval_;
+	int dcqcn_byte_thresh_;
+	int dcqcn_f_;	//fast recovery steps
+	double dcqcn_rai_;	//additive increase
+	double dcqcn_rhai_;	//hyper additive increase
+	double dcqcn_cnp_interval_;
+	int ncnp_;	//CNPs received
+
+	/*
+	 * Homa: the sender sends the first homa_rtt_bytes_ of a message
+	 * unscheduled, at a priority from the message size and the PIAS
+	 * thresholds, and the rest only as the receiver grants it. A
+	 * receiver reports each message to the grant controller of its
+	 * host, which grants the overcommit_ messages with the fewest bytes
+	 * left, each up to homa_rtt_bytes_ past what has arrived, at the
+	 * priorities below the unscheduled ones. Grants ride on ACKs.
+	 * Without a controller, every message is granted.
+	 */
+	void homa_init();
+	void homa_data(hdr_tcp *tcph, int datalen);	//receiver: data arrived
+	int homa_ack(hdr_tcp *tcph);	//sender: TRUE if the ACK moved the grant
+	int homa_allowed(int seq);	//sender: unscheduled or granted
+	int homa_unsched_prio(int size);
+	HomaGrantController *homa_ctrl_;	//grant controller of this host
+	int homa_grant_;	//sender: may send below this seq# (-1: none)
+	int homa_prio_;	//sender: priority of granted data (-1: none)
+	int homa_end_;	//receiver: end of the message being received
+	int homa_rcvd_;	//receiver: highest seq# received
+	int homa_rgrant_;	//receiver: grant sent (-1: none)
+	int homa_rprio_;
+	int homa_rtt_bytes_;	//unscheduled bytes and bytes granted ahead
+	int homa_prio_num_;	//priorities in all
+
 	int startseq_;
 	int last_prio_;
 	int seq_bound_;
@@ -134,6 +529,11 @@ protected:
 	double start_time; //start time
 	int early_terminated_; //early terminated
 
+	/* packet trimming */
+	int ntrimrexmit_;	// number of segments retransmitted on NACKs
+	void send_nack(int seqno);	// receiver: NACK a trimmed segment
+	void trim_rexmit(int seqno);	// sender: retransmit a NACKed segment
+
 	int closed_;
 	int ts_option_size_;	// header bytes in a ts option
 	int pipe_;		// estimate of pipe occupancy (for Sack)
@@ -166,6 +566,18 @@ protected:
 
 	// Mohammad: if non-zero, set dupack threshold to max(3, dynamic_dupack_ * cwnd)_
 	double dynamic_dupack_;
+	int reorder_thresh_;	// dupack threshold learned from DSACKs, 0 if none
+	int rexmt_thresh() {	// dupacks needed for fast retransmit
+		return (reorder_thresh_ > tcprexmtthresh_ ? reorder_thresh_ : tcprexmtthresh_);
+	}
+
+	/* duplicate data to report in the next DSACK block, none if left >= right */
+	int dsack_left_;
+	int dsack_right_;
+	void dsack_note(int start, int end) {
+		dsack_left_ = start;
+		dsack_right_ = end;
+	}
 
 	int close_on_empty_;	// close conn when buffer empty
 	int signal_on_empty_;	// signal when buffer is empty
@@ -201,6 +613,11 @@ protected:
 
 	void finish();
 	void reset_rtx_timer(int);  	// adjust the rtx timer
+	virtual void set_rtx_timer();
+	virtual void cancel_rtx_timer();
+	int rtx_pending() { return (rtx_deadline_ >= 0.0); }	// rtx timer set?
+	void delack_set(double delay);	// set the delayed ACK timer
+	void delack_cancel();
 
 	virtual void timeout_action();	// what to do on rtx timeout
 	virtual void dupack_action();	// what to do on dup acks
@@ -224,6 +641,10 @@ protected:
 	virtual void oldack() {			// what to do on old ack
 		dupacks_ = 0;
 	}
+	virtual void tx_stamp(int, int) { }	// data went out (seq, len)
+	virtual int rack_detect() {		// an unacked seg lost by time?
+		return (FALSE);
+	}
 
 	virtual void extra_ack() {		// dup ACKs after threshold
 		if (reno_fastrecov_)
@@ -240,6 +661,9 @@ protected:
 	int pack(Packet* pkt);		// is this a partial ack?
 	void dooptions(Packet*);	// process option(s)
 	DelAckTimer delack_timer_;	// other timers in tcp.h
+	PaceTimer pace_timer_;
+	DcqcnAlphaTimer dcqcn_alpha_timer_;
+	DcqcnRateTimer dcqcn_rate_timer_;
 	void cancel_timers();		// cancel all timers
 	void prpkt(Packet*);		// print packet (debugging helper)
 	char *flagstr(int);		// print header flags as symbols
@@ -259,7 +683,7 @@ protected:
 	int last_state_; /* FSM state at last pkt recv */
 	int rcv_nxt_;       /* next sequence number expected */
 
-	ReassemblyQueue rq_;    /* TCP reassembly queue */
+	IntervalReassemblyQueue rq_;    /* TCP reassembly queue */
 	/*
 	* the following are part of a tcpcb in "real" RFC1323 TCP
 	*/
@@ -294,8 +718,12 @@ protected:
 class SackFullTcpAgent : public FullTcpAgent {
 public:
 	SackFullTcpAgent() :
-		sq_(sack_min_), sack_min_(-1), h_seqno_(-1) { }
-	~SackFullTcpAgent() { rq_.clear(); }
+		ndsack_(0), sq_(sack_min_), sack_min_(-1), h_seqno_(-1), h_scan_(-1),
+		tlp_(0), ntlp_(0), tlp_high_(-1), tlp_deadline_(-1.0), tlp_sched_(-1.0),
+		tlp_timer_(this), rack_(0), nrack_(0), rack_xmit_ts_(-1.0), rack_end_(-1),
+		rack_rtt_(0.0), rack_reo_mult_(1), rack_timer_(this) { }
+	~SackFullTcpAgent() { cancel_timers(); rq_.clear(); }
+	virtual void timeout(int tno);
 protected:
 	virtual void delay_bind_init_all();
 	virtual int delay_bind_dispatch(const char *varName, const char *localName, TclObject *tracer);
@@ -320,7 +748,9 @@ protected:
 	int clear_on_timeout_;	// clear sender's SACK queue on RTX timeout?
 	int sack_option_size_;	// base # bytes for sack opt (no blks)
 	int sack_block_size_;	// # bytes in a sack block (def: 8)
-	int max_sack_blocks_;	// max # sack blocks to send
+	int max_sack_blocks_;	// max # sack blocks to send (at most MAX_NSA)
+	int dsack_reorder_;	// sender: raise the dupack threshold on DSACKs
+	int ndsack_;		// number of DSACKs received
 	int sack_rtx_bthresh_;	// hole-fill byte threshold
 	int sack_rtx_cthresh_;	// hole-fill counter threshold
 	int sack_rtx_threshmode_;	// hole-fill mode setting
@@ -330,9 +760,46 @@ protected:
 	//XXX not implemented?
 	//void	sendpacket(int seqno, int ackno, int pflags, int datalen, int reason, Packet *p=0);
 
-	ReassemblyQueue sq_;	// SACK queue, used by sender
+	IntervalReassemblyQueue sq_;	// SACK queue, used by sender
 	int sack_min_;		// first seq# in sack queue, initializes sq_
 	int h_seqno_;		// next seq# to hole-fill
+	int h_scan_;		// holes below were skipped by nxt_tseq, -1 if none
+
+	virtual void cancel_timers();
+	virtual void cancel_rtx_timer();
+
+	/*
+	 * Tail Loss Probe: when no ACK comes back within 2*srtt of the
+	 * latest transmission (before the RTO), the last segment is sent
+	 * again so that the ACK of the probe starts recovery of a lost
+	 * tail without a timeout.
+	 */
+	void tlp_arm();		// (re)schedule the probe
+	void tlp_probe();
+	int tlp_;		// send tail loss probes?
+	int ntlp_;		// number of probes sent
+	int tlp_high_;		// maxseq_ when the outstanding probe was sent, -1 if none
+	double tlp_deadline_;	// probe time (-1: not set), lazy as the rtx timer
+	double tlp_sched_;	// time of the scheduled probe event
+	TlpTimer tlp_timer_;
+
+	/*
+	 * RACK: an unacked segment is lost once a segment sent after
+	 * it has been delivered and an RTT plus a reordering window has
+	 * passed since it was sent, even with fewer dupacks than needed.
+	 */
+	virtual void tx_stamp(int seq, int len);
+	virtual int rack_detect();
+	void rack_update(int seq);	// segment containing seq was delivered
+	double rack_reo_wnd();
+	int rack_;		// time based loss detection?
+	int nrack_;		// fast retransmits started by RACK
+	double rack_xmit_ts_;	// latest send time of a delivered segment (-1: none)
+	int rack_end_;		// end seq# of that segment
+	double rack_rtt_;	// RTT of that segment
+	int rack_reo_mult_;	// reordering window in quarters of min RTT, raised by DSACKs
+	SendTimeQueue stq_;
+	RackTimer rack_timer_;
 };
 
 class MinTcpAgent : public SackFullTcpAgent {
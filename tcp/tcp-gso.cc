@@ -0,0 +1,59 @@
+#include "tcp-gso.h"
+#include "tcp-full.h"
+#include "flags.h"
+
+static class GsoSegmenterClass : public TclClass {
+public:
+	GsoSegmenterClass() : TclClass("GsoSegmenter") {}
+	TclObject* create(int, const char*const*) {
+		return (new GsoSegmenter());
+	}
+} class_gso_segmenter;
+
+GsoSegmenter::GsoSegmenter() : nsuper_(0), nsegs_(0)
+{
+	bind("nsuper_", &nsuper_);
+	bind("nsegs_", &nsegs_);
+}
+
+/*
+ * Each segment is a copy of the super-segment headers with its own seq#
+ * and size. Only the last one keeps FIN and PUSH, and only the first one
+ * keeps CWR. Each segment gets a uid of its own, as if allocated by the agent.
+ */
+void GsoSegmenter::recv(Packet *p, Handler *h)
+{
+	hdr_tcp *tcph = hdr_tcp::access(p);
+	hdr_cmn *ch = hdr_cmn::access(p);
+	int mss = tcph->gso_size();
+	int hlen = tcph->hlen();
+	int seqno = tcph->seqno();
+	int datalen = ch->size() - hlen;
+	int flags = tcph->flags();
+
+	if (mss <= 0 || datalen <= mss) {
+		send(p, h);
+		return;
+	}
+
+	nsuper_++;
+	tcph->gso_size() = 0;
+	for (int off = 0; off < datalen; off += mss) {
+		int last = (off + mss >= datalen);
+		Packet *q = last ? p : p->copy();
+		hdr_tcp *qtcph = hdr_tcp::access(q);
+
+		qtcph->seqno() = seqno + off;
+		qtcph->flags() = flags;
+		if (!last)
+			qtcph->flags() &= ~(TH_FIN|TH_PUSH);
+		if (off > 0) {
+			qtcph->flags() &= ~TH_CWR;
+			hdr_flags::access(q)->cong_action() = 0;
+		}
+		hdr_cmn::access(q)->size() = (last ? datalen - off : mss) + hlen;
+		hdr_cmn::access(q)->uid() = FullTcpAgent::new_uid();
+		nsegs_++;
+		send(q, h);
+	}
+}
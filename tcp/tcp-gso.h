@@ -0,0 +1,23 @@
+#ifndef ns_tcp_gso_h
+#define ns_tcp_gso_h
+
+#include "connector.h"
+
+/*
+ * Segmentation stage for TSO super-segments of FullTcp. It sits between
+ * an agent and its node, and splits a super-segment into MSS sized
+ * segments before the first link, so that queues, ECN marking and the
+ * receiver see the same packets as without TSO. This saves agent-side
+ * events only (send_much() iterations, header builds and allocations);
+ * every link and queue still schedules one event per MSS segment.
+ */
+class GsoSegmenter : public Connector {
+public:
+	GsoSegmenter();
+	virtual void recv(Packet *p, Handler *h);
+protected:
+	int nsuper_;	// super-segments split
+	int nsegs_;	// segments sent from them
+};
+
+#endif
@@ -45,7 +45,9 @@ TcpAgent::TcpAgent()
           use_rtt_(0), qs_requested_(0), qs_approved_(0),
 	  qs_window_(0), qs_cwnd_(0), frto_(0), ecnhat_recalc_seq(0), ecnhat_num_marked(0),ecnhat_total(0),
 	  ecnhat_maxseq(0), ecnhat_not_marked(0), ecnhat_mark_period(0), target_wnd(0) , ecnhat_tcp_friendly_increase_(1.0),
-      lldct_(false), lldct_w_min_(0.125), lldct_w_max_(2.5), lldct_size_min_(200*1024), lldct_size_max_(1024*1024)
+      lldct_(false), lldct_w_min_(0.125), lldct_w_max_(2.5), lldct_size_min_(200*1024), lldct_size_max_(1024*1024),
+	  min_rtt_win_(10.0), rto_hires_(0), rtt_hist_(0), rtt_hist_bins_(NULL), rtt_hist_num_(0),
+	  accecn_(0), ace_ce_rcvd_(0), ace_ect_rcvd_(0), ace_ce_last_(0), ace_ect_last_(0)
 {
 #ifdef TCP_DELAY_BIND_ALL
         // defined since Dec 1999.
@@ -117,6 +119,7 @@ TcpAgent::delay_bind_init_all()
 	delay_bind_init_one("ecnhat_enable_beta_");
 	delay_bind_init_one("ecnhat_quadratic_beta_");
 	delay_bind_init_one("ecnhat_tcp_friendly_");
+	delay_bind_init_one("accecn_");
 
 	// Wei
 	delay_bind_init_one("lldct_");
@@ -198,6 +201,9 @@ TcpAgent::delay_bind_init_all()
         delay_bind_init_one("rtt_");
         delay_bind_init_one("srtt_");
         delay_bind_init_one("rttvar_");
+        delay_bind_init_one("min_rtt_win_");
+        delay_bind_init_one("rto_hires_");
+        delay_bind_init_one("rtt_hist_");
         delay_bind_init_one("backoff_");
         delay_bind_init_one("dupacks_");
         delay_bind_init_one("seqno_");
@@ -245,6 +251,7 @@ TcpAgent::delay_bind_dispatch(const char *varName, const char *localName, TclObj
 	if (delay_bind(varName, localName, "ecnhat_beta_", &ecnhat_beta_ , tracer)) return TCL_OK;
 	if (delay_bind_bool(varName, localName, "ecnhat_quadratic_beta_", &ecnhat_quadratic_beta_ , tracer)) return TCL_OK;
 	if (delay_bind_bool(varName, localName, "ecnhat_tcp_friendly_", &ecnhat_tcp_friendly_, tracer)) return TCL_OK;
+	if (delay_bind_bool(varName, localName, "accecn_", &accecn_, tracer)) return TCL_OK;
 	// Wei
 	if (delay_bind_bool(varName, localName, "lldct_", &lldct_ , tracer)) return TCL_OK;
 	if (delay_bind(varName, localName, "lldct_w_min_", &lldct_w_min_ , tracer)) return TCL_OK;
@@ -282,6 +289,9 @@ TcpAgent::delay_bind_dispatch(const char *varName, const char *localName, TclObj
         if (delay_bind(varName, localName, "T_SRTT_BITS", &T_SRTT_BITS , tracer)) return TCL_OK;
         if (delay_bind(varName, localName, "T_RTTVAR_BITS", &T_RTTVAR_BITS , tracer)) return TCL_OK;
         if (delay_bind(varName, localName, "rttvar_exp_", &rttvar_exp_ , tracer)) return TCL_OK;
+        if (delay_bind_time(varName, localName, "min_rtt_win_", &min_rtt_win_ , tracer)) return TCL_OK;
+        if (delay_bind_bool(varName, localName, "rto_hires_", &rto_hires_ , tracer)) return TCL_OK;
+        if (delay_bind_bool(varName, localName, "rtt_hist_", &rtt_hist_ , tracer)) return TCL_OK;
         if (delay_bind(varName, localName, "awnd_", &awnd_ , tracer)) return TCL_OK;
         if (delay_bind(varName, localName, "decrease_num_", &decrease_num_, tracer)) return TCL_OK;
         if (delay_bind(varName, localName, "increase_num_", &increase_num_, tracer)) return TCL_OK;
@@ -502,6 +512,8 @@ TcpAgent::reset()
 	necnresponses_ = 0;
 	ncwndcuts_ = 0;
 	ncwndcuts1_ = 0;
+	ace_ce_rcvd_ = ace_ect_rcvd_ = 0;
+	ace_ce_last_ = ace_ect_last_ = 0;
         cancel_timers();      // suggested by P. Anelli.
 
 	if (control_increase_) {
@@ -542,21 +554,29 @@ void TcpAgent::rtt_init()
 	t_rttvar_ = int(rttvar_init_ / tcp_tick_) << T_RTTVAR_BITS;
 	t_rtxcur_ = rtxcur_init_;
 	t_backoff_ = 1;
+
+	rtt_last_ = rtt_srtt_ = rtt_var_ = rtt_rtxcur_ = 0;
+	for (int i = 0; i < 3; i++)
+		rtt_min_[i].t = rtt_min_[i].v = 0;
+	if (rtt_hist_bins_)
+		memset(rtt_hist_bins_, 0, RTT_HIST_BINS * sizeof(int));
+	rtt_hist_num_ = 0;
 }
 
 double TcpAgent::rtt_timeout()
 {
 	double timeout;
+	double rtxcur = (rto_hires_ && rtt_rtxcur_ > 0) ? rtt_rtxcur_ : t_rtxcur_;
 	if (rfc2988_) {
 	// Correction from Tom Kelly to be RFC2988-compliant, by
 	// clamping minrto_ before applying t_backoff_.
-		if (t_rtxcur_ < minrto_ && !use_rtt_)
+		if (rtxcur < minrto_ && !use_rtt_)
 			timeout = minrto_ * t_backoff_;
 		else
-			timeout = t_rtxcur_ * t_backoff_;
+			timeout = rtxcur * t_backoff_;
 	} else {
 		// only of interest for backwards compatibility
-		timeout = t_rtxcur_ * t_backoff_;
+		timeout = rtxcur * t_backoff_;
 		if (timeout < minrto_)
 			timeout = minrto_;
 	}
@@ -585,6 +605,7 @@ double TcpAgent::rtt_timeout()
 void TcpAgent::rtt_update(double tao)
 {
 	double now = Scheduler::instance().clock();
+	rtt_sample(tao);
 	//printf("%f\n", tao);
 	if (ts_option_)
 		t_rtt_ = int(tao /tcp_tick_ + 0.5);
@@ -629,6 +650,97 @@ void TcpAgent::rtt_update(double tao)
 	return;
 }
 
+/*
+ * Same estimator as rtt_update() in seconds, without the tick rounding.
+ * The min-RTT filter keeps the three best samples of the window, each
+ * from a later part of it, as in Linux's windowed min-max.
+ */
+void TcpAgent::rtt_sample(double tao)
+{
+	double now = Scheduler::instance().clock();
+	RttMinSample val;
+
+	if (tao <= 0)
+		return;
+	rtt_last_ = tao;
+
+	if (rtt_srtt_ > 0) {
+		double delta = tao - rtt_srtt_;
+		rtt_srtt_ += ldexp(delta, -T_SRTT_BITS);
+		rtt_var_ += ldexp(fabs(delta) - rtt_var_, -T_RTTVAR_BITS);
+	} else {
+		rtt_srtt_ = tao;
+		rtt_var_ = tao / 2;
+	}
+	rtt_rtxcur_ = rtt_srtt_ + ldexp(rtt_var_, rttvar_exp_);
+
+	val.t = now;
+	val.v = tao;
+	if (rtt_min_[0].v <= 0 || tao <= rtt_min_[0].v ||
+	    now - rtt_min_[2].t > min_rtt_win_) {
+		rtt_min_[0] = rtt_min_[1] = rtt_min_[2] = val;
+	} else {
+		if (tao <= rtt_min_[1].v)
+			rtt_min_[2] = rtt_min_[1] = val;
+		else if (tao <= rtt_min_[2].v)
+			rtt_min_[2] = val;
+
+		double dt = now - rtt_min_[0].t;
+		if (dt > min_rtt_win_) {
+			rtt_min_[0] = rtt_min_[1];
+			rtt_min_[1] = rtt_min_[2];
+			rtt_min_[2] = val;
+			if (now - rtt_min_[0].t > min_rtt_win_) {
+				rtt_min_[0] = rtt_min_[1];
+				rtt_min_[1] = rtt_min_[2];
+			}
+		} else if (rtt_min_[1].t == rtt_min_[0].t && dt > min_rtt_win_ / 4) {
+			rtt_min_[2] = rtt_min_[1] = val;
+		} else if (rtt_min_[2].t == rtt_min_[1].t && dt > min_rtt_win_ / 2) {
+			rtt_min_[2] = val;
+		}
+	}
+
+	if (rtt_hist_) {
+		int e = 0;
+		double m = frexp(tao * 1e9, &e);	/* tao in ns = m * 2^e */
+		int bin = (e - 1) * RTT_HIST_SUB + (int)((2 * m - 1) * RTT_HIST_SUB);
+
+		if (!rtt_hist_bins_) {
+			rtt_hist_bins_ = new int[RTT_HIST_BINS];
+			memset(rtt_hist_bins_, 0, RTT_HIST_BINS * sizeof(int));
+		}
+		if (bin < 0)
+			bin = 0;
+		else if (bin >= RTT_HIST_BINS)
+			bin = RTT_HIST_BINS - 1;
+		rtt_hist_bins_[bin]++;
+		rtt_hist_num_++;
+	}
+}
+
+/* RTT below which a fraction p of the samples fall, to the bin width */
+double TcpAgent::rtt_percentile(double p)
+{
+	int rank = 0, n = 0;
+
+	if (!rtt_hist_bins_ || rtt_hist_num_ == 0)
+		return (0);
+
+	rank = (int)ceil(p * rtt_hist_num_);
+	if (rank < 1)
+		rank = 1;
+	for (int i = 0; i < RTT_HIST_BINS; i++) {
+		n += rtt_hist_bins_[i];
+		if (n >= rank) {
+			int e = i / RTT_HIST_SUB;
+			int sub = i % RTT_HIST_SUB;
+			return (ldexp(1.0 + (double)(sub + 1) / RTT_HIST_SUB, e) * 1e-9);
+		}
+	}
+	return (rtt_srtt_);
+}
+
 void TcpAgent::rtt_backoff()
 {
 	//if (t_backoff_ < 64 || rfc2988_)
@@ -645,6 +757,8 @@ void TcpAgent::rtt_backoff()
 		 */
 		t_rttvar_ += (t_srtt_ >> T_SRTT_BITS);
 		t_srtt_ = 0;
+		rtt_var_ += rtt_srtt_;
+		rtt_srtt_ = 0;
 	}
 }
 
@@ -859,6 +973,10 @@ int TcpAgent::command(int argc, const char*const* argv)
 			et_ = (EventTrace *)TclObject::lookup(argv[2]);
 			return (TCL_OK);
 		}
+		if (strcmp(argv[1], "rtt-percentile") == 0) {
+			Tcl::instance().resultf("%.9f", rtt_percentile(atof(argv[2])));
+			return (TCL_OK);
+		}
 		/*
 		 * Curtis Villamizar's trick to transfer tcp connection
 		 * parameters to emulate http persistent connections.
@@ -1551,21 +1669,35 @@ void TcpAgent::ecn(int seqno)
  */
 void TcpAgent::update_ecnhat_alpha(Packet *pkt)
 {
+	hdr_tcp *tcph = hdr_tcp::access(pkt);
 	int ecnbit = hdr_flags::access(pkt)->ecnecho();
-	int ackno = hdr_tcp::access(pkt)->ackno();
+	int ackno = tcph->ackno();
+	int marked = 0, total = 0;
+
+	/* AccECN: bytes delivered and marked since the latest ACK */
+	if (accecn_ && tcph->ace_ect_bytes() > 0) {
+		total = tcph->ace_ect_bytes() - ace_ect_last_;
+		marked = tcph->ace_ce_bytes() - ace_ce_last_;
+		if (total <= 0)
+			return;	// nothing new, or an ACK reordered behind a later one
+		ace_ect_last_ = tcph->ace_ect_bytes();
+		ace_ce_last_ = tcph->ace_ce_bytes();
+	}
+
+	if (total == 0) {
+		/* one ECE bit: all or none of the acked bytes were marked */
+		total = ackno - highest_ack_;
+		if (total <= 0)
+			total = size_;
+		marked = ecnbit ? total : 0;
+	}
 
 	if (!ecnhat_smooth_alpha_)
-		ecnhat_alpha_ = (1 - ecnhat_g_) * ecnhat_alpha_ + ecnhat_g_ * ecnbit;
+		ecnhat_alpha_ = (1 - ecnhat_g_) * ecnhat_alpha_ + ecnhat_g_ * marked / total;
 	else {
-	        int acked_bytes = ackno - highest_ack_;
-		if (acked_bytes <= 0)
-		  acked_bytes = size_;
-		//printf("size_ = %d, acked_bytes = %d\n",size_, acked_bytes);
-		//ecnhat_total++;
-		ecnhat_total += acked_bytes;
-		if (ecnbit) {
-		  //ecnhat_num_marked++;
-		        ecnhat_num_marked += acked_bytes;
+		ecnhat_total += total;
+		if (marked > 0) {
+		        ecnhat_num_marked += marked;
 		        ecnhat_beta_ = 1;
 		}
 		if (ackno > ecnhat_recalc_seq) { //update roughly per-RTT
@@ -6,14 +6,27 @@
 
 //class EventTrace;
 
+#define MAX_INT_HOPS 8	/* INT records a packet can carry */
+
+/* in-band network telemetry of one hop, stamped as the packet leaves the port */
+struct IntHop {
+	double ts;		/* time */
+	double txbytes;		/* bytes sent by the port so far */
+	double rate;		/* link capacity in bps */
+	int qlen;		/* queue length in bytes */
+};
+
 struct hdr_tcp {
 #define NSA 3
+#define MAX_NSA 16	/* bound of max_sack_blocks_ */
 	double ts_;             /* time packet generated (at source) */
 	double ts_echo_;        /* the echoed timestamp (originally sent by
 	                           the peer) */
+	double ack_delay_;	/* time the echoed segment was held by the
+				   receiver before this ACK (FullTcp) */
 	int seqno_;             /* sequence number */
 	int reason_;            /* reason for a retransmit */
-	int sack_area_[NSA+1][2];	/* sack blocks: start, end of block */
+	int sack_area_[MAX_NSA+1][2];	/* sack blocks: start, end of block */
 	int sa_length_;         /* Indicate the number of SACKs in this  *
 	                         * packet.  Adds 2+sack_length*8 bytes   */
 	int ackno_;             /* ACK number for FullTcp */
@@ -21,6 +34,18 @@ struct hdr_tcp {
 	int tcp_flags_;         /* TCP flags for FullTcp */
 	int last_rtt_;		/* more recent RTT measurement in ms, */
 				/*   for statistics only */
+	int trimmed_;		/* payload cut by a switch (packet trimming) */
+	int nackno_;		/* seq # of a trimmed segment, for FullTcp NACKs */
+	int gso_size_;		/* MSS of a TSO super-segment, 0 if not one */
+	int int_on_;		/* switches append INT records? */
+	int int_nhop_;		/* INT records in int_hop_ (stamped, or echoed on an ACK) */
+	IntHop int_hop_[MAX_INT_HOPS];
+	int cnp_;		/* congestion notification packet (DCQCN) */
+	int homa_end_;		/* data: end of the sender's message (Homa) */
+	int homa_grant_;	/* ACK: the sender may send below this seq# */
+	int homa_prio_;		/* ACK: priority of the granted data */
+	int ace_ce_bytes_;	/* AccECN: CE marked bytes received */
+	int ace_ect_bytes_;	/* AccECN: ECN capable bytes received (0: off) */
 
 	static int offset_;	// offset for this header
 	inline static int& offset() { return offset_; }
@@ -31,6 +56,7 @@ struct hdr_tcp {
 	/* per-field member functions */
 	double& ts() { return (ts_); }
 	double& ts_echo() { return (ts_echo_); }
+	double& ack_delay() { return (ack_delay_); }
 	int& seqno() { return (seqno_); }
 	int& reason() { return (reason_); }
 	int& sa_left(int n) { return (sack_area_[n][0]); }
@@ -40,6 +66,18 @@ struct hdr_tcp {
 	int& ackno() { return (ackno_); }
 	int& flags() { return (tcp_flags_); }
 	int& last_rtt() { return (last_rtt_); }
+	int& trimmed() { return (trimmed_); }
+	int& nackno() { return (nackno_); }
+	int& gso_size() { return (gso_size_); }
+	int& int_on() { return (int_on_); }
+	int& int_nhop() { return (int_nhop_); }
+	IntHop& int_hop(int n) { return (int_hop_[n]); }
+	int& cnp() { return (cnp_); }
+	int& homa_end() { return (homa_end_); }
+	int& homa_grant() { return (homa_grant_); }
+	int& homa_prio() { return (homa_prio_); }
+	int& ace_ce_bytes() { return (ace_ce_bytes_); }
+	int& ace_ect_bytes() { return (ace_ect_bytes_); }
 };
 
 /* these are used to mark packets as to why we xmitted them */
@@ -95,6 +133,10 @@ struct hdr_tcp {
 
 class TcpAgent;
 
+/* RTT histogram: RTT_HIST_SUB bins per power of two of nanoseconds */
+#define RTT_HIST_SUB	4
+#define RTT_HIST_BINS	(32 * RTT_HIST_SUB)
+
 class RtxTimer : public TimerHandler {
 public:
 	RtxTimer(TcpAgent *a) : TimerHandler() { a_ = a; }
@@ -144,7 +186,7 @@ class TcpAgent : public Agent {
 	friend class XcpEndsys;
 public:
 	TcpAgent();
-	virtual ~TcpAgent() {free(tss);}
+	virtual ~TcpAgent() {free(tss); delete [] rtt_hist_bins_;}
         virtual void recv(Packet*, Handler*);
 	virtual void timeout(int tno);
 	virtual void timeout_nonrtx(int tno);
@@ -250,6 +292,32 @@ virtual void output(int seqno, int reason = 0);
 	virtual double rtt_timeout();	/* provide RTO based on RTT estimates */
 	virtual void rtt_update(double tao);	/* update RTT estimate */
 	virtual void rtt_backoff();		/* double multiplier */
+
+	/*
+	 * Double precision RTT estimate in seconds, kept by rtt_update()
+	 * alongside the tick based one, with a windowed min-RTT and an
+	 * optional histogram for percentiles. 0 means no sample yet.
+	 */
+	void rtt_sample(double tao);	/* feed an RTT sample */
+	double rtt_last() { return (rtt_last_); }
+	double rtt_srtt() { return (rtt_srtt_); }
+	double rtt_var() { return (rtt_var_); }
+	double rtt_min() { return (rtt_min_[0].v); }	/* over min_rtt_win_ */
+	double rtt_percentile(double p);	/* needs rtt_hist_ */
+	struct RttMinSample {
+		double t;	/* time of the sample */
+		double v;	/* RTT */
+	};
+	RttMinSample rtt_min_[3];	/* best, 2nd and 3rd best in the window */
+	double rtt_last_;
+	double rtt_srtt_;
+	double rtt_var_;
+	double rtt_rtxcur_;	/* RTO before backoff from rtt_srtt_ */
+	double min_rtt_win_;	/* window of the min-RTT filter */
+	int rto_hires_;		/* base the RTO on rtt_rtxcur_ */
+	int rtt_hist_;		/* keep an RTT histogram */
+	int *rtt_hist_bins_;	/* allocated on the first sample */
+	int rtt_hist_num_;
 	/* End of state for the round-trip-time estimate. */
 
         /* RTOs: */
@@ -416,6 +484,17 @@ virtual void output(int seqno, int reason = 0);
 	int dctcp_enable_ap;
 	double target_wnd;
 
+	/*
+	 * AccECN: the receiver echoes byte counters of the ECN capable and
+	 * CE marked data it got, so the sender updates ecnhat_alpha_ from
+	 * exact deltas however many segments an ACK covers.
+	 */
+	int accecn_;
+	int ace_ce_rcvd_;	/* receiver: CE marked bytes */
+	int ace_ect_rcvd_;	/* receiver: ECN capable bytes */
+	int ace_ce_last_;	/* sender: counters on the latest ACK */
+	int ace_ect_last_;
+
 	void update_ecnhat_alpha(Packet *pkt); /* updates the ecnhat alpha value */
 
 	/* Wei: added for LLDCT (low latency data center transport) */